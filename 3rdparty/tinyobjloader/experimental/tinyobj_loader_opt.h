@@ -41,6 +41,7 @@ THE SOFTWARE.
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
@@ -313,8 +314,8 @@ typedef struct {
 
 typedef struct {
   std::string name;  // group name or object name.
-  unsigned int face_offset;
-  unsigned int length;
+  size_t face_offset;
+  size_t length;
 } shape_t;
 
 struct index_t {
@@ -993,49 +994,36 @@ typedef enum {
 
 } CommandType;
 
+// A name on a `usemtl`, `mtllib`, `g` or `o` line, pointing into the .obj
+// buffer.
 typedef struct {
-  float vx, vy, vz;
-  float nx, ny, nz;
-  float tx, ty;
-
-  // for f
-  std::vector<index_t, lt::allocator<index_t> > f;
-  // std::vector<index_t> f;
-  std::vector<int, lt::allocator<int> > f_num_verts;
-
-  const char *group_name;
-  unsigned int group_name_len;
-  const char *object_name;
-  unsigned int object_name_len;
-  const char *material_name;
-  unsigned int material_name_len;
-
-  const char *mtllib_name;
-  unsigned int mtllib_name_len;
-
-  CommandType type;
-} Command;
-
-struct CommandCount {
-  size_t num_v;
-  size_t num_vn;
-  size_t num_vt;
-  size_t num_f;
-  size_t num_indices;
-  CommandCount() {
-    num_v = 0;
-    num_vn = 0;
-    num_vt = 0;
-    num_f = 0;
-    num_indices = 0;
-  }
-};
+  const char *name;
+  unsigned int len;
+} NameRef;
+
+// Everything one thread parsed. `commands` holds the CommandType of each
+// parsed line in file order, and the data of the line is appended to the
+// arrays for its type, so parsing only allocates when one of them grows.
+typedef struct {
+  std::vector<unsigned char, lt::allocator<unsigned char> > commands;
+  std::vector<float, lt::allocator<float> > vertices;   // `v`, 3 per line
+  std::vector<float, lt::allocator<float> > normals;    // `vn`, 3 per line
+  std::vector<float, lt::allocator<float> > texcoords;  // `vt`, 2 per line
+  // `f`: indices as written in the file, vertices per face and faces per line
+  std::vector<index_t, lt::allocator<index_t> > indices;
+  std::vector<int, lt::allocator<int> > face_num_verts;
+  std::vector<unsigned int, lt::allocator<unsigned int> > line_faces;
+  std::vector<NameRef, lt::allocator<NameRef> > names;  // `usemtl`, `mtllib`,
+                                                         // `g` and `o`
+} CommandBuffer;
 
 class LoadOption {
  public:
-  LoadOption() : req_num_threads(-1), triangulate(true), verbose(false) {}
+  LoadOption()
+      : req_num_threads(-1), chunk_size(0), triangulate(true), verbose(false) {}
 
   int req_num_threads;
+  size_t chunk_size;
   bool triangulate;
   bool verbose;
 };
@@ -1043,13 +1031,16 @@ class LoadOption {
 /// Parse wavefront .obj(.obj string data is expanded to linear char array
 /// `buf')
 /// -1 to req_num_threads use the number of HW threads in the running system.
+/// `buf' is split into line aligned chunks of about chunk_size bytes which
+/// threads pick up as they become free. 0 to chunk_size picks a size from
+/// `len' and the number of threads.
 bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
               std::vector<material_t> *materials, const char *buf, size_t len,
               const LoadOption &option);
 
 #ifdef TINYOBJ_LOADER_OPT_IMPLEMENTATION
 
-static bool parseLine(Command *command, const char *p, size_t p_len,
+static bool parseLine(CommandBuffer *commands, const char *p, size_t p_len,
                       bool triangulate = true) {
   // @todo { operate directly on pointer `p'. to do that, add range check for
   // string operatoion against `p', since `p' is not null-terminated at p[p_len]
@@ -1061,8 +1052,6 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
 
   const char *token = linebuf;
 
-  command->type = COMMAND_EMPTY;
-
   // Skip leading space.
   skip_space(&token);
 
@@ -1080,10 +1069,10 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 2;
     float x = 0.0f, y = 0.0f, z = 0.0f;
     parseFloat3(&x, &y, &z, &token);
-    command->vx = x;
-    command->vy = y;
-    command->vz = z;
-    command->type = COMMAND_V;
+    commands->vertices.push_back(x);
+    commands->vertices.push_back(y);
+    commands->vertices.push_back(z);
+    commands->commands.push_back(COMMAND_V);
     return true;
   }
 
@@ -1092,10 +1081,10 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 3;
     float x = 0.0f, y = 0.0f, z = 0.0f;
     parseFloat3(&x, &y, &z, &token);
-    command->nx = x;
-    command->ny = y;
-    command->nz = z;
-    command->type = COMMAND_VN;
+    commands->normals.push_back(x);
+    commands->normals.push_back(y);
+    commands->normals.push_back(z);
+    commands->commands.push_back(COMMAND_VN);
     return true;
   }
 
@@ -1104,9 +1093,9 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 3;
     float x = 0.0f, y = 0.0f;
     parseFloat2(&x, &y, &token);
-    command->tx = x;
-    command->ty = y;
-    command->type = COMMAND_VT;
+    commands->texcoords.push_back(x);
+    commands->texcoords.push_back(y);
+    commands->commands.push_back(COMMAND_VT);
     return true;
   }
 
@@ -1124,7 +1113,7 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
       f->push_back(vi);
     }
 
-    command->type = COMMAND_F;
+    commands->commands.push_back(COMMAND_F);
 
     if (triangulate) {
       index_t i0 = f[0];
@@ -1134,19 +1123,22 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
       for (size_t k = 2; k < f->size(); k++) {
         i1 = i2;
         i2 = f[k];
-        command->f.emplace_back(i0);
-        command->f.emplace_back(i1);
-        command->f.emplace_back(i2);
+        commands->indices.push_back(i0);
+        commands->indices.push_back(i1);
+        commands->indices.push_back(i2);
 
-        command->f_num_verts.emplace_back(3);
+        commands->face_num_verts.push_back(3);
       }
+      commands->line_faces.push_back(
+          f->size() > 2 ? static_cast<unsigned int>(f->size() - 2) : 0);
 
     } else {
       for (size_t k = 0; k < f->size(); k++) {
-        command->f.emplace_back(f[k]);
+        commands->indices.push_back(f[k]);
       }
 
-      command->f_num_verts.emplace_back(f->size());
+      commands->face_num_verts.push_back(static_cast<int>(f->size()));
+      commands->line_faces.push_back(1);
     }
 
     return true;
@@ -1171,10 +1163,11 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // namebuf + strlen(namebuf));
     // command->material_name->push_back('\0');
     skip_space(&token);
-    command->material_name = p + (token - linebuf);
-    command->material_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_USEMTL;
+    NameRef name;
+    name.name = p + (token - linebuf);
+    name.len = length_until_newline(token, p_len - (token - linebuf)) + 1;
+    commands->names.push_back(name);
+    commands->commands.push_back(COMMAND_USEMTL);
 
     return true;
   }
@@ -1185,10 +1178,11 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     token += 7;
 
     skip_space(&token);
-    command->mtllib_name = p + (token - linebuf);
-    command->mtllib_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_MTLLIB;
+    NameRef name;
+    name.name = p + (token - linebuf);
+    name.len = length_until_newline(token, p_len - (token - linebuf)) + 1;
+    commands->names.push_back(name);
+    commands->commands.push_back(COMMAND_MTLLIB);
 
     return true;
   }
@@ -1198,10 +1192,11 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // @todo { multiple group name. }
     token += 2;
 
-    command->group_name = p + (token - linebuf);
-    command->group_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_G;
+    NameRef name;
+    name.name = p + (token - linebuf);
+    name.len = length_until_newline(token, p_len - (token - linebuf)) + 1;
+    commands->names.push_back(name);
+    commands->commands.push_back(COMMAND_G);
 
     return true;
   }
@@ -1211,10 +1206,11 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
     // @todo { multiple object name? }
     token += 2;
 
-    command->object_name = p + (token - linebuf);
-    command->object_name_len =
-        length_until_newline(token, p_len - (token - linebuf)) + 1;
-    command->type = COMMAND_O;
+    NameRef name;
+    name.name = p + (token - linebuf);
+    name.len = length_until_newline(token, p_len - (token - linebuf)) + 1;
+    commands->names.push_back(name);
+    commands->commands.push_back(COMMAND_O);
 
     return true;
   }
@@ -1222,18 +1218,27 @@ static bool parseLine(Command *command, const char *p, size_t p_len,
   return false;
 }
 
+// A line aligned range of the .obj buffer, parsed as one piece of work.
 typedef struct {
   size_t pos;
   size_t len;
-} LineInfo;
+} ChunkInfo;
+
+// An `o` or `g` line found while constructing shapes.
+typedef struct {
+  size_t face_count;  // `f` lines before it in the same thread's commands
+  NameRef name;
+} ShapeBoundary;
 
 // Idea come from https://github.com/antonmks/nvParse
 // 1. mmap file
-// 2. find newline(\n, \r\n, \r) and list of line data.
-// 3. Do parallel parsing for each line.
+// 2. split the data into line aligned chunks at newlines(\n, \r\n, \r).
+// 3. Do parallel parsing for each chunk.
 // 4. Reconstruct final mesh data structure.
 
-#define kMaxThreads (32)
+// Smallest chunk picked when LoadOption::chunk_size is 0. Smaller chunks
+// balance better but cost more bookkeeping in the merge.
+#define kMinChunkSize (64 * 1024)
 
 static inline bool is_line_ending(const char *p, size_t i, size_t end_i) {
   if (p[i] == '\0') return true;
@@ -1246,6 +1251,28 @@ static inline bool is_line_ending(const char *p, size_t i, size_t end_i) {
   return false;
 }
 
+// Calls fn(i) for every i in [0, count) on up to num_threads threads,
+// including the calling one. Each thread takes the next i as soon as it is
+// done with the previous one, so uneven items still keep every thread busy.
+template <typename F>
+static void parallel_for(size_t count, size_t num_threads, const F &fn) {
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < std::min(num_threads, count); t++) {
+    workers.push_back(std::thread(work));
+  }
+  work();
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+}
+
 bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
               std::vector<material_t> *materials, const char *buf, size_t len,
               const LoadOption &option) {
@@ -1259,11 +1286,10 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   if (len < 1) return false;
 
-  auto num_threads = (option.req_num_threads < 0)
-                         ? std::thread::hardware_concurrency()
-                         : option.req_num_threads;
-  num_threads =
-      std::max(1, std::min(static_cast<int>(num_threads), kMaxThreads));
+  size_t num_threads = (option.req_num_threads < 0)
+                           ? std::thread::hardware_concurrency()
+                           : static_cast<size_t>(option.req_num_threads);
+  num_threads = std::max(num_threads, static_cast<size_t>(1));
 
   if (option.verbose) {
     std::cout << "# of threads = " << num_threads << std::endl;
@@ -1271,13 +1297,6 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
   auto t1 = std::chrono::high_resolution_clock::now();
 
-  std::vector<LineInfo, lt::allocator<LineInfo> > line_infos[kMaxThreads];
-  for (size_t t = 0; t < static_cast<size_t>(num_threads); t++) {
-    // Pre allocate enough memory. len / 128 / num_threads is just a heuristic
-    // value.
-    line_infos[t].reserve(len / 128 / num_threads);
-  }
-
   std::chrono::duration<double, std::milli> ms_linedetection;
   std::chrono::duration<double, std::milli> ms_alloc;
   std::chrono::duration<double, std::milli> ms_parse;
@@ -1285,66 +1304,31 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   std::chrono::duration<double, std::milli> ms_merge;
   std::chrono::duration<double, std::milli> ms_construct;
 
-  // 1. Find '\n' and create line data.
+  // 1. Split the buffer into chunks, each ending after a line break. Many
+  // more chunks than threads keep the threads evenly loaded when some parts of
+  // the file are slower to parse than others, e.g. faces after vertices.
+  std::vector<ChunkInfo> chunks;
   {
-    StackVector<std::thread, 16> workers;
-
     auto start_time = std::chrono::high_resolution_clock::now();
-    auto chunk_size = len / num_threads;
-
-    for (size_t t = 0; t < static_cast<size_t>(num_threads); t++) {
-      workers->push_back(std::thread([&, t]() {
-        auto start_idx = (t + 0) * chunk_size;
-        auto end_idx = std::min((t + 1) * chunk_size, len - 1);
-        if (t == static_cast<size_t>((num_threads - 1))) {
-          end_idx = len - 1;
-        }
 
-        size_t prev_pos = start_idx;
-        for (size_t i = start_idx; i < end_idx; i++) {
-          if (is_line_ending(buf, i, end_idx)) {
-            if ((t > 0) && (prev_pos == start_idx) &&
-                (!is_line_ending(buf, start_idx - 1, end_idx))) {
-              // first linebreak found in (chunk > 0), and a line before this
-              // linebreak belongs to previous chunk, so skip it.
-              prev_pos = i + 1;
-              continue;
-            } else {
-              LineInfo info;
-              info.pos = prev_pos;
-              info.len = i - prev_pos;
-
-              if (info.len > 0) {
-                line_infos[t].push_back(info);
-              }
-
-              prev_pos = i + 1;
-            }
-          }
-        }
-
-        // Find extra line which spand across chunk boundary.
-        if ((t < num_threads) && (buf[end_idx - 1] != '\n')) {
-          auto extra_span_idx = std::min(end_idx - 1 + chunk_size, len - 1);
-          for (size_t i = end_idx; i < extra_span_idx; i++) {
-            if (is_line_ending(buf, i, extra_span_idx)) {
-              LineInfo info;
-              info.pos = prev_pos;
-              info.len = i - prev_pos;
-
-              if (info.len > 0) {
-                line_infos[t].push_back(info);
-              }
-
-              break;
-            }
-          }
-        }
-      }));
+    size_t chunk_size = option.chunk_size;
+    if (chunk_size == 0) {
+      chunk_size = std::max(len / (num_threads * 16),
+                            static_cast<size_t>(kMinChunkSize));
     }
 
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
+    size_t pos = 0;
+    while (pos < len) {
+      size_t end = std::min(pos + chunk_size, len);
+      while (end < len && !is_line_ending(buf, end - 1, len)) {
+        end++;
+      }
+
+      ChunkInfo chunk;
+      chunk.pos = pos;
+      chunk.len = end - pos;
+      chunks.push_back(chunk);
+      pos = end;
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
@@ -1352,70 +1336,55 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     ms_linedetection = end_time - start_time;
   }
 
-  auto line_sum = 0;
-  for (size_t t = 0; t < num_threads; t++) {
-    // std::cout << t << ": # of lines = " << line_infos[t].size() << std::endl;
-    line_sum += line_infos[t].size();
+  size_t num_chunks = chunks.size();
+  if (option.verbose) {
+    std::cout << "# of chunks = " << num_chunks << std::endl;
   }
-  // std::cout << "# of lines = " << line_sum << std::endl;
 
-  std::vector<Command> commands[kMaxThreads];
-
-  // 2. allocate buffer
   auto t_alloc_start = std::chrono::high_resolution_clock::now();
-  {
-    for (size_t t = 0; t < num_threads; t++) {
-      commands[t].reserve(line_infos[t].size());
-    }
-  }
 
-  CommandCount command_count[kMaxThreads];
-  // Array index to `mtllib` line. According to wavefront .obj spec, `mtllib'
-  // should appear only once in .obj.
-  int mtllib_t_index = -1;
-  int mtllib_i_index = -1;
+  std::vector<CommandBuffer> commands(num_chunks);
+
+  // Index into the names of each chunk of its first `mtllib` line. According
+  // to wavefront .obj spec, `mtllib' should appear only once in .obj.
+  std::vector<long long> mtllib_name_index(num_chunks, -1);
+
+  // Index into the names of each chunk of its last `usemtl` line, which
+  // carries over to the faces of the following chunks.
+  std::vector<long long> usemtl_name_index(num_chunks, -1);
 
   ms_alloc = std::chrono::high_resolution_clock::now() - t_alloc_start;
 
-  // 2. parse each line in parallel.
+  // 2. parse the lines of each chunk in parallel.
   {
-    StackVector<std::thread, 16> workers;
     auto t_start = std::chrono::high_resolution_clock::now();
 
-    for (size_t t = 0; t < num_threads; t++) {
-      workers->push_back(std::thread([&, t]() {
-
-        for (size_t i = 0; i < line_infos[t].size(); i++) {
-          Command command;
-          bool ret = parseLine(&command, &buf[line_infos[t][i].pos],
-                               line_infos[t][i].len, option.triangulate);
-          if (ret) {
-            if (command.type == COMMAND_V) {
-              command_count[t].num_v++;
-            } else if (command.type == COMMAND_VN) {
-              command_count[t].num_vn++;
-            } else if (command.type == COMMAND_VT) {
-              command_count[t].num_vt++;
-            } else if (command.type == COMMAND_F) {
-              command_count[t].num_f += command.f.size();
-              command_count[t].num_indices += command.f_num_verts.size();
-            }
-
-            if (command.type == COMMAND_MTLLIB) {
-              mtllib_t_index = t;
-              mtllib_i_index = commands->size();
-            }
-
-            commands[t].emplace_back(std::move(command));
-          }
-        }
+    parallel_for(num_chunks, num_threads, [&](size_t c) {
+      CommandBuffer &buffer = commands[c];
+      size_t end = chunks[c].pos + chunks[c].len;
+      size_t line_start = chunks[c].pos;
 
-      }));
-    }
+      // A last line without a line break ends at the end of the buffer.
+      for (size_t i = chunks[c].pos; i <= end; i++) {
+        if (i < end && !is_line_ending(buf, i, len)) {
+          continue;
+        }
 
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
-    }
+        if (i > line_start) {
+          bool ret = parseLine(&buffer, &buf[line_start], i - line_start,
+                               option.triangulate);
+          if (ret && buffer.commands.back() == COMMAND_MTLLIB &&
+              mtllib_name_index[c] < 0) {
+            mtllib_name_index[c] =
+                static_cast<long long>(buffer.names.size()) - 1;
+          } else if (ret && buffer.commands.back() == COMMAND_USEMTL) {
+            usemtl_name_index[c] =
+                static_cast<long long>(buffer.names.size()) - 1;
+          }
+        }
+        line_start = i + 1;
+      }
+    });
 
     auto t_end = std::chrono::high_resolution_clock::now();
 
@@ -1425,12 +1394,15 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   std::map<std::string, int> material_map;
 
   // Load material(if exits)
-  if (mtllib_i_index >= 0 && mtllib_t_index >= 0 &&
-      commands[mtllib_t_index][mtllib_i_index].mtllib_name &&
-      commands[mtllib_t_index][mtllib_i_index].mtllib_name_len > 0) {
+  const NameRef *mtllib_name = NULL;
+  for (size_t c = 0; c < num_chunks && mtllib_name == NULL; c++) {
+    if (mtllib_name_index[c] >= 0) {
+      mtllib_name = &commands[c].names[mtllib_name_index[c]];
+    }
+  }
+  if (mtllib_name && mtllib_name->name && mtllib_name->len > 0) {
     std::string material_filename =
-        std::string(commands[mtllib_t_index][mtllib_i_index].mtllib_name,
-                    commands[mtllib_t_index][mtllib_i_index].mtllib_name_len);
+        std::string(mtllib_name->name, mtllib_name->len);
     // std::cout << "mtllib :" << material_filename << std::endl;
 
     auto t1 = std::chrono::high_resolution_clock::now();
@@ -1449,11 +1421,11 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     ms_load_mtl = t2 - t1;
   }
 
-  auto command_sum = 0;
-  for (size_t t = 0; t < num_threads; t++) {
-    // std::cout << t << ": # of commands = " << commands[t].size() <<
+  size_t command_sum = 0;
+  for (size_t c = 0; c < num_chunks; c++) {
+    // std::cout << c << ": # of commands = " << commands[c].size() <<
     // std::endl;
-    command_sum += commands[t].size();
+    command_sum += commands[c].commands.size();
   }
   // std::cout << "# of commands = " << command_sum << std::endl;
 
@@ -1462,12 +1434,12 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   size_t num_vt = 0;
   size_t num_f = 0;
   size_t num_indices = 0;
-  for (size_t t = 0; t < num_threads; t++) {
-    num_v += command_count[t].num_v;
-    num_vn += command_count[t].num_vn;
-    num_vt += command_count[t].num_vt;
-    num_f += command_count[t].num_f;
-    num_indices += command_count[t].num_indices;
+  for (size_t c = 0; c < num_chunks; c++) {
+    num_v += commands[c].vertices.size() / 3;
+    num_vn += commands[c].normals.size() / 3;
+    num_vt += commands[c].texcoords.size() / 2;
+    num_f += commands[c].indices.size();
+    num_indices += commands[c].face_num_verts.size();
   }
 
   // std::cout << "# v " << num_v << std::endl;
@@ -1476,7 +1448,6 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   // std::cout << "# f " << num_f << std::endl;
 
   // 4. merge
-  // @todo { parallelize merge. }
   {
     auto t_start = std::chrono::high_resolution_clock::now();
 
@@ -1487,91 +1458,109 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     attrib->face_num_verts.resize(num_indices);
     attrib->material_ids.resize(num_indices);
 
-    size_t v_offsets[kMaxThreads];
-    size_t n_offsets[kMaxThreads];
-    size_t t_offsets[kMaxThreads];
-    size_t f_offsets[kMaxThreads];
-    size_t face_offsets[kMaxThreads];
+    // -1 = default unknown material.
+    auto find_material = [&](const NameRef &name, int current) {
+      if (!name.name || name.len == 0) {
+        return current;
+      }
+      std::map<std::string, int>::const_iterator it =
+          material_map.find(std::string(name.name, name.len));
+      // Assign invalid material ID if not found
+      return it != material_map.end() ? it->second : -1;
+    };
+
+    std::vector<size_t> v_offsets(num_chunks);
+    std::vector<size_t> n_offsets(num_chunks);
+    std::vector<size_t> t_offsets(num_chunks);
+    std::vector<size_t> f_offsets(num_chunks);
+    std::vector<size_t> face_offsets(num_chunks);
+    std::vector<int> start_material_ids(num_chunks);
 
     v_offsets[0] = 0;
     n_offsets[0] = 0;
     t_offsets[0] = 0;
     f_offsets[0] = 0;
     face_offsets[0] = 0;
-
-    for (size_t t = 1; t < num_threads; t++) {
-      v_offsets[t] = v_offsets[t - 1] + command_count[t - 1].num_v;
-      n_offsets[t] = n_offsets[t - 1] + command_count[t - 1].num_vn;
-      t_offsets[t] = t_offsets[t - 1] + command_count[t - 1].num_vt;
-      f_offsets[t] = f_offsets[t - 1] + command_count[t - 1].num_f;
-      face_offsets[t] = face_offsets[t - 1] + command_count[t - 1].num_indices;
+    start_material_ids[0] = -1;
+
+    for (size_t c = 1; c < num_chunks; c++) {
+      v_offsets[c] = v_offsets[c - 1] + commands[c - 1].vertices.size() / 3;
+      n_offsets[c] = n_offsets[c - 1] + commands[c - 1].normals.size() / 3;
+      t_offsets[c] = t_offsets[c - 1] + commands[c - 1].texcoords.size() / 2;
+      f_offsets[c] = f_offsets[c - 1] + commands[c - 1].indices.size();
+      face_offsets[c] =
+          face_offsets[c - 1] + commands[c - 1].face_num_verts.size();
+
+      // A chunk starts with the material of the last `usemtl` before it
+      start_material_ids[c] = start_material_ids[c - 1];
+      if (usemtl_name_index[c - 1] >= 0) {
+        start_material_ids[c] = find_material(
+            commands[c - 1].names[usemtl_name_index[c - 1]], -1);
+      }
     }
 
-    StackVector<std::thread, 16> workers;
-
-    for (size_t t = 0; t < num_threads; t++) {
-      int material_id = -1;  // -1 = default unknown material.
-      workers->push_back(std::thread([&, t]() {
-        size_t v_count = v_offsets[t];
-        size_t n_count = n_offsets[t];
-        size_t t_count = t_offsets[t];
-        size_t f_count = f_offsets[t];
-        size_t face_count = face_offsets[t];
-
-        for (size_t i = 0; i < commands[t].size(); i++) {
-          if (commands[t][i].type == COMMAND_EMPTY) {
-            continue;
-          } else if (commands[t][i].type == COMMAND_USEMTL) {
-            if (commands[t][i].material_name &&
-                commands[t][i].material_name_len > 0) {
-              std::string material_name(commands[t][i].material_name,
-                                        commands[t][i].material_name_len);
-
-              if (material_map.find(material_name) != material_map.end()) {
-                material_id = material_map[material_name];
-              } else {
-                // Assign invalid material ID
-                material_id = -1;
-              }
-            }
-          } else if (commands[t][i].type == COMMAND_V) {
-            attrib->vertices[3 * v_count + 0] = commands[t][i].vx;
-            attrib->vertices[3 * v_count + 1] = commands[t][i].vy;
-            attrib->vertices[3 * v_count + 2] = commands[t][i].vz;
-            v_count++;
-          } else if (commands[t][i].type == COMMAND_VN) {
-            attrib->normals[3 * n_count + 0] = commands[t][i].nx;
-            attrib->normals[3 * n_count + 1] = commands[t][i].ny;
-            attrib->normals[3 * n_count + 2] = commands[t][i].nz;
-            n_count++;
-          } else if (commands[t][i].type == COMMAND_VT) {
-            attrib->texcoords[2 * t_count + 0] = commands[t][i].tx;
-            attrib->texcoords[2 * t_count + 1] = commands[t][i].ty;
-            t_count++;
-          } else if (commands[t][i].type == COMMAND_F) {
-            for (size_t k = 0; k < commands[t][i].f.size(); k++) {
-              index_t &vi = commands[t][i].f[k];
-              int vertex_index = fixIndex(vi.vertex_index, v_count);
-              int texcoord_index = fixIndex(vi.texcoord_index, t_count);
-              int normal_index = fixIndex(vi.normal_index, n_count);
-              attrib->indices[f_count + k] =
-                  index_t(vertex_index, texcoord_index, normal_index);
-            }
-            for (size_t k = 0; k < commands[t][i].f_num_verts.size(); k++) {
-							attrib->material_ids[face_count + k] = material_id;
-							attrib->face_num_verts[face_count + k] = commands[t][i].f_num_verts[k];
-            }
-
-            f_count += commands[t][i].f.size();
-            face_count += commands[t][i].f_num_verts.size();
+    parallel_for(num_chunks, num_threads, [&](size_t c) {
+      const CommandBuffer &buffer = commands[c];
+      int material_id = start_material_ids[c];
+
+      // Attributes need no fixing up and are copied as a whole
+      std::copy(buffer.vertices.begin(), buffer.vertices.end(),
+                attrib->vertices.begin() + 3 * v_offsets[c]);
+      std::copy(buffer.normals.begin(), buffer.normals.end(),
+                attrib->normals.begin() + 3 * n_offsets[c]);
+      std::copy(buffer.texcoords.begin(), buffer.texcoords.end(),
+                attrib->texcoords.begin() + 2 * t_offsets[c]);
+
+      // Relative indices refer to the attributes defined so far, so faces
+      // are resolved in line order
+      size_t v_count = v_offsets[c];
+      size_t n_count = n_offsets[c];
+      size_t t_count = t_offsets[c];
+      size_t f_count = f_offsets[c];
+      size_t face_count = face_offsets[c];
+      size_t index_pos = 0;
+      size_t face_pos = 0;
+      size_t line_pos = 0;
+      size_t name_pos = 0;
+
+      for (size_t i = 0; i < buffer.commands.size(); i++) {
+        unsigned char type = buffer.commands[i];
+        if (type == COMMAND_USEMTL) {
+          material_id = find_material(buffer.names[name_pos++], material_id);
+        } else if (type == COMMAND_MTLLIB || type == COMMAND_G ||
+                   type == COMMAND_O) {
+          name_pos++;
+        } else if (type == COMMAND_V) {
+          v_count++;
+        } else if (type == COMMAND_VN) {
+          n_count++;
+        } else if (type == COMMAND_VT) {
+          t_count++;
+        } else if (type == COMMAND_F) {
+          size_t faces = buffer.line_faces[line_pos++];
+          size_t num_verts = 0;
+          for (size_t k = 0; k < faces; k++) {
+            int face_verts = buffer.face_num_verts[face_pos + k];
+            attrib->material_ids[face_count + k] = material_id;
+            attrib->face_num_verts[face_count + k] = face_verts;
+            num_verts += face_verts;
+          }
+          for (size_t k = 0; k < num_verts; k++) {
+            const index_t &vi = buffer.indices[index_pos + k];
+            int vertex_index = fixIndex(vi.vertex_index, v_count);
+            int texcoord_index = fixIndex(vi.texcoord_index, t_count);
+            int normal_index = fixIndex(vi.normal_index, n_count);
+            attrib->indices[f_count + k] =
+                index_t(vertex_index, texcoord_index, normal_index);
           }
-        }
-      }));
-    }
 
-    for (size_t t = 0; t < workers->size(); t++) {
-      workers[t].join();
-    }
+          index_pos += num_verts;
+          face_pos += faces;
+          f_count += num_verts;
+          face_count += faces;
+        }
+      }
+    });
 
     auto t_end = std::chrono::high_resolution_clock::now();
     ms_merge = t_end - t_start;
@@ -1580,71 +1569,97 @@ bool parseObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   auto t4 = std::chrono::high_resolution_clock::now();
 
   // 5. Construct shape information.
+  //
+  // Every `o`/`g` line ends the shape opened by the one before it (if any `f`
+  // lines came in between) and opens a new one. Faces before the first `o`/`g`
+  // line form a shape without a name.
   {
     auto t_start = std::chrono::high_resolution_clock::now();
 
-    // @todo { Can we boost the performance by multi-threaded execution? }
-    int face_count = 0;
-    shape_t shape;
-    shape.face_offset = 0;
-    shape.length = 0;
-    int face_prev_offset = 0;
-    for (size_t t = 0; t < num_threads; t++) {
-      for (size_t i = 0; i < commands[t].size(); i++) {
-        if (commands[t][i].type == COMMAND_O ||
-            commands[t][i].type == COMMAND_G) {
-          std::string name;
-          if (commands[t][i].type == COMMAND_O) {
-            name = std::string(commands[t][i].object_name,
-                               commands[t][i].object_name_len);
-          } else {
-            name = std::string(commands[t][i].group_name,
-                               commands[t][i].group_name_len);
-          }
-
-          if (face_count == 0) {
-            // 'o' or 'g' appears before any 'f'
-            shape.name = name;
-            shape.face_offset = face_count;
-            face_prev_offset = face_count;
-          } else {
-            if (shapes->size() == 0) {
-              // 'o' or 'g' after some 'v' lines.
-              // create a shape with null name
-              shape.length = face_count - face_prev_offset;
-              face_prev_offset = face_count;
-
-              shapes->push_back(shape);
-
-            } else {
-              if ((face_count - face_prev_offset) > 0) {
-                // push previous shape
-                shape.length = face_count - face_prev_offset;
-                shapes->push_back(shape);
-                face_prev_offset = face_count;
-              }
-            }
-
-            // redefine shape.
-            shape.name = name;
-            shape.face_offset = face_count;
-            shape.length = 0;
-          }
-        }
-        if (commands[t][i].type == COMMAND_F) {
+    // Each chunk lists its `o`/`g` lines together with the number of `f` lines
+    // before them in the same chunk.
+    std::vector<std::vector<ShapeBoundary> > boundaries(num_chunks);
+    std::vector<size_t> chunk_face_counts(num_chunks);
+    parallel_for(num_chunks, num_threads, [&](size_t c) {
+      const CommandBuffer &buffer = commands[c];
+      size_t face_count = 0;
+      size_t name_pos = 0;
+      for (size_t i = 0; i < buffer.commands.size(); i++) {
+        unsigned char type = buffer.commands[i];
+        if (type == COMMAND_O || type == COMMAND_G) {
+          ShapeBoundary boundary;
+          boundary.face_count = face_count;
+          boundary.name = buffer.names[name_pos];
+          boundaries[c].push_back(boundary);
+        } else if (type == COMMAND_F) {
           face_count++;
         }
+        if (type == COMMAND_USEMTL || type == COMMAND_MTLLIB ||
+            type == COMMAND_G || type == COMMAND_O) {
+          name_pos++;
+        }
+      }
+      chunk_face_counts[c] = face_count;
+    });
+
+    // Prefix sums turn the per-chunk face counts into global offsets, and find
+    // the shape each chunk starts in.
+    std::vector<size_t> chunk_face_offsets(num_chunks);
+    std::vector<shape_t> open_shapes(num_chunks + 1);
+    open_shapes[0].face_offset = 0;
+    open_shapes[0].length = 0;
+    chunk_face_offsets[0] = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+      if (c > 0) {
+        chunk_face_offsets[c] =
+            chunk_face_offsets[c - 1] + chunk_face_counts[c - 1];
+      }
+      open_shapes[c + 1] = open_shapes[c];
+      if (!boundaries[c].empty()) {
+        open_shapes[c + 1].name.assign(boundaries[c].back().name.name,
+                                       boundaries[c].back().name.len);
+        open_shapes[c + 1].face_offset =
+            chunk_face_offsets[c] + boundaries[c].back().face_count;
       }
     }
 
-    if ((face_count - face_prev_offset) > 0) {
-      shape.length = face_count - shape.face_offset;
-      if (shape.length > 0) {
-        shapes->push_back(shape);
+    // Each chunk closes the shapes its `o`/`g` lines end.
+    std::vector<std::vector<shape_t> > chunk_shapes(num_chunks);
+    parallel_for(num_chunks, num_threads, [&](size_t c) {
+      shape_t shape = open_shapes[c];
+      chunk_shapes[c].reserve(boundaries[c].size());
+      for (size_t i = 0; i < boundaries[c].size(); i++) {
+        size_t face_offset =
+            chunk_face_offsets[c] + boundaries[c][i].face_count;
+        if (face_offset > shape.face_offset) {
+          shape.length = face_offset - shape.face_offset;
+          chunk_shapes[c].push_back(std::move(shape));
+        }
+        shape.name.assign(boundaries[c][i].name.name,
+                          boundaries[c][i].name.len);
+        shape.face_offset = face_offset;
+        shape.length = 0;
       }
-    } else {
-      // Guess no 'v' line occurrence after 'o' or 'g', so discards current
-      // shape information.
+    });
+
+    size_t shape_count = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+      shape_count += chunk_shapes[c].size();
+    }
+    shapes->reserve(shape_count + 1);
+    for (size_t c = 0; c < num_chunks; c++) {
+      for (size_t i = 0; i < chunk_shapes[c].size(); i++) {
+        shapes->push_back(std::move(chunk_shapes[c][i]));
+      }
+    }
+
+    // The last shape runs until the end of the file
+    size_t face_count =
+        chunk_face_offsets[num_chunks - 1] + chunk_face_counts[num_chunks - 1];
+    shape_t &last_shape = open_shapes[num_chunks];
+    if (face_count > last_shape.face_offset) {
+      last_shape.length = face_count - last_shape.face_offset;
+      shapes->push_back(last_shape);
     }
 
     auto t_end = std::chrono::high_resolution_clock::now();
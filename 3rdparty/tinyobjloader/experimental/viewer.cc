@@ -102,11 +102,6 @@ const char *mmap_file(size_t *len, const char* filename)
     assert(fileMapView != NULL);
 #else
 
-  FILE* f = fopen(filename, "r" );
-  fseek(f, 0, SEEK_END);
-  long fileSize = ftell(f);
-  fclose(f);
-
   struct stat sb;
   char *p;
   int fd;
@@ -127,6 +122,8 @@ const char *mmap_file(size_t *len, const char* filename)
     return NULL;
   }
 
+  // st_size rather than ftell, long is 32 bits on some platforms
+  size_t fileSize = static_cast<size_t>(sb.st_size);
   p = (char*)mmap (0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
 
   if (p == MAP_FAILED) {
@@ -594,10 +591,49 @@ static void Init() {
 }
 
 
+// Parses the data with 1, 2, 4, ... up to max_threads threads and prints the
+// best of a few runs for each, to see how parsing scales with the core count.
+static bool BenchmarkScaling(const char* data, size_t data_len, int max_threads)
+{
+  const int kRuns = 3;
+  double base_ms = 0.0;
+
+  printf("threads      ms  speedup  efficiency\n");
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    double best_ms = std::numeric_limits<double>::max();
+    for (int run = 0; run < kRuns; run++) {
+      tinyobj_opt::attrib_t attrib;
+      std::vector<tinyobj_opt::shape_t> shapes;
+      std::vector<tinyobj_opt::material_t> materials;
+
+      tinyobj_opt::LoadOption option;
+      option.req_num_threads = num_threads;
+
+      auto t_begin = std::chrono::high_resolution_clock::now();
+      if (!parseObj(&attrib, &shapes, &materials, data, data_len, option)) {
+        return false;
+      }
+      auto t_end = std::chrono::high_resolution_clock::now();
+
+      std::chrono::duration<double, std::milli> ms = t_end - t_begin;
+      best_ms = std::min(best_ms, ms.count());
+    }
+
+    if (num_threads == 1) {
+      base_ms = best_ms;
+    }
+    printf("%7d %7.1f %8.2f %10.2f\n", num_threads, best_ms, base_ms / best_ms,
+           base_ms / best_ms / num_threads);
+  }
+
+  return true;
+}
+
 int main(int argc, char **argv)
 {
   if (argc < 2) {
     std::cout << "view input.obj <num_threads> <benchark_only> <verbose>" << std::endl;
+    std::cout << "  benchark_only 2 measures scaling from 1 to num_threads (default 128) threads" << std::endl;
     return 0;
   }
 
@@ -631,6 +667,11 @@ int main(int argc, char **argv)
       return false;
     }
     printf("filesize: %d\n", (int)data_len);
+
+    if (atoi(argv[3]) == 2) {
+      return BenchmarkScaling(data, data_len, num_threads > 0 ? num_threads : 128) ? 0 : -1;
+    }
+
     tinyobj_opt::LoadOption option;
     option.req_num_threads = num_threads;
     option.verbose = true;
@@ -4,6 +4,7 @@ import json
 model = tol.LoadObj("cornell_box_multimaterial.obj")
 
 #print(model["shapes"], model["materials"])
-print( json.dumps(model, indent=4) )
+# vertex data and mesh arrays are numpy arrays, turn them into lists for json
+print( json.dumps(model, indent=4, default=lambda array: array.tolist()) )
 
 #see cornell_box_output.json
@@ -3,17 +3,109 @@
 // usage:
 // import tinyobjloader as tol
 // model = tol.LoadObj(name)
+// print(model["attrib"]["vertices"])
 // print(model["shapes"])
 // print(model["materials"]
 // note:
-//   `shape.mesh.index_t` is represented as flattened array: (vertex_index, normal_index, texcoord_index) * num_faces
+//   Vertex data and mesh arrays are returned as NumPy arrays sharing memory
+//   with the parsed model (or as memoryviews when NumPy is not installed),
+//   so no Python object is created per element.
+//   `attrib.vertices` and `attrib.normals` have shape (n, 3), `attrib.texcoords` (n, 2).
+//   `shape.mesh.indices` has shape (n, 3): (vertex_index, normal_index, texcoord_index) per index.
 
 #include <Python.h>
 #include <vector>
 #include "../tiny_obj_loader.h"
 
-typedef std::vector<double> vectd;
-typedef std::vector<int> vecti;
+// Everything LoadObj parsed. Owned by a capsule that every array returned for
+// it keeps alive.
+struct ParsedObj {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+};
+
+// Exports a slice of a ParsedObj through the buffer protocol.
+typedef struct {
+  PyObject_HEAD
+  PyObject* owner;
+  void* data;
+  int ndim;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+  Py_ssize_t itemsize;
+  const char* format;
+} ArrayView;
+
+static PyTypeObject ArrayViewType = {PyVarObject_HEAD_INIT(NULL, 0)};
+static PyBufferProcs ArrayViewBuffer;
+static PyObject* numpyAsarray = NULL;
+static char emptyData[16];
+
+static void destroyParsedObj(PyObject* capsule) {
+  delete static_cast<ParsedObj*>(PyCapsule_GetPointer(capsule, "tinyobjloader.ParsedObj"));
+}
+
+static void ArrayView_dealloc(PyObject* obj) {
+  ArrayView* self = reinterpret_cast<ArrayView*>(obj);
+  Py_XDECREF(self->owner);
+  Py_TYPE(obj)->tp_free(obj);
+}
+
+static int ArrayView_getbuffer(PyObject* obj, Py_buffer* view, int flags) {
+  ArrayView* self = reinterpret_cast<ArrayView*>(obj);
+
+  view->obj = obj;
+  Py_INCREF(obj);
+  view->buf = self->data;
+  view->len = self->shape[0] * self->strides[0];
+  view->readonly = 0;
+  view->itemsize = self->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(self->format) : NULL;
+  view->ndim = self->ndim;
+  view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+  view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+// Wraps count rows of cols items each without copying them. Returns a NumPy
+// array when NumPy is available and a memoryview otherwise.
+static PyObject* makeArray(PyObject* owner, const void* data, size_t count,
+                           int cols, Py_ssize_t itemsize, const char* format) {
+  ArrayView* view = PyObject_New(ArrayView, &ArrayViewType);
+  if (view == NULL) return NULL;
+
+  Py_INCREF(owner);
+  view->owner = owner;
+  view->data = count > 0 ? const_cast<void*>(data) : emptyData;
+  view->ndim = cols > 1 ? 2 : 1;
+  view->shape[0] = static_cast<Py_ssize_t>(count);
+  view->shape[1] = cols;
+  view->strides[0] = itemsize * cols;
+  view->strides[1] = itemsize;
+  view->itemsize = itemsize;
+  view->format = format;
+
+  PyObject* memory = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(view));
+  Py_DECREF(view);
+  if (memory == NULL || numpyAsarray == NULL) return memory;
+
+  PyObject* array = PyObject_CallFunctionObjArgs(numpyAsarray, memory, NULL);
+  Py_DECREF(memory);
+  return array;
+}
+
+// Like PyDict_SetItemString, but takes over the reference to value.
+static void setItem(PyObject* dict, const char* key, PyObject* value) {
+  if (value == NULL) {
+    PyErr_Clear();
+    return;
+  }
+  PyDict_SetItemString(dict, key, value);
+  Py_DECREF(value);
+}
 
 PyObject* pyTupleFromfloat3(float array[3]) {
   int i;
@@ -29,149 +121,109 @@ PyObject* pyTupleFromfloat3(float array[3]) {
 extern "C" {
 
 static PyObject* pyLoadObj(PyObject* self, PyObject* args) {
-  PyObject *rtndict, *pyshapes, *pymaterials, *attribobj, *current, *meshobj;
+  PyObject *rtndict, *pyshapes, *pymaterials, *attribobj, *meshobj, *owner;
 
-  char const* current_name;
   char const* filename;
-  vectd vect;
-  std::vector<tinyobj::index_t> indices;
-  std::vector<unsigned char> face_verts;
-
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
 
   if (!PyArg_ParseTuple(args, "s", &filename)) return NULL;
 
+  ParsedObj* parsed = new ParsedObj();
   std::string err;
-  tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename);
+
+  // Parsing touches no Python objects, so other threads may run meanwhile
+  Py_BEGIN_ALLOW_THREADS
+  tinyobj::LoadObj(&parsed->attrib, &parsed->shapes, &parsed->materials, &err,
+                   filename);
+  Py_END_ALLOW_THREADS
+
+  owner = PyCapsule_New(parsed, "tinyobjloader.ParsedObj", destroyParsedObj);
+  if (owner == NULL) {
+    delete parsed;
+    return NULL;
+  }
+
+  const tinyobj::attrib_t& attrib = parsed->attrib;
 
   pyshapes = PyDict_New();
   pymaterials = PyDict_New();
   rtndict = PyDict_New();
 
   attribobj = PyDict_New();
-
-  for (int i = 0; i <= 2; i++) {
-    current = PyList_New(0);
-
-    switch (i) {
-      case 0:
-        current_name = "vertices";
-        vect = vectd(attrib.vertices.begin(), attrib.vertices.end());
-        break;
-      case 1:
-        current_name = "normals";
-        vect = vectd(attrib.normals.begin(), attrib.normals.end());
-        break;
-      case 2:
-        current_name = "texcoords";
-        vect = vectd(attrib.texcoords.begin(), attrib.texcoords.end());
-        break;
-    }
-
-    for (vectd::iterator it = vect.begin(); it != vect.end(); it++) {
-      PyList_Insert(current, it - vect.begin(), PyFloat_FromDouble(*it));
-    }
-
-    PyDict_SetItemString(attribobj, current_name, current);
-  }
-
-  for (std::vector<tinyobj::shape_t>::iterator shape = shapes.begin();
-       shape != shapes.end(); shape++) {
+  setItem(attribobj, "vertices",
+          makeArray(owner, attrib.vertices.data(), attrib.vertices.size() / 3,
+                    3, sizeof(float), "f"));
+  setItem(attribobj, "normals",
+          makeArray(owner, attrib.normals.data(), attrib.normals.size() / 3, 3,
+                    sizeof(float), "f"));
+  setItem(attribobj, "texcoords",
+          makeArray(owner, attrib.texcoords.data(),
+                    attrib.texcoords.size() / 2, 2, sizeof(float), "f"));
+
+  for (std::vector<tinyobj::shape_t>::iterator shape = parsed->shapes.begin();
+       shape != parsed->shapes.end(); shape++) {
     meshobj = PyDict_New();
-    tinyobj::mesh_t cm = (*shape).mesh;
-
-    {
-      current = PyList_New(0);
-
-      for (size_t i = 0; i < cm.indices.size(); i++) {
-        // Flatten index array: v_idx, vn_idx, vt_idx, v_idx, vn_idx, vt_idx,
-        // ...
-        PyList_Insert(current, 3 * i + 0,
-                      PyLong_FromLong(cm.indices[i].vertex_index));
-        PyList_Insert(current, 3 * i + 1,
-                      PyLong_FromLong(cm.indices[i].normal_index));
-        PyList_Insert(current, 3 * i + 2,
-                      PyLong_FromLong(cm.indices[i].texcoord_index));
-      }
-
-      PyDict_SetItemString(meshobj, "indices", current);
-    }
-
-    {
-      current = PyList_New(0);
-
-      for (size_t i = 0; i < cm.num_face_vertices.size(); i++) {
-        // Widen data type to long.
-        PyList_Insert(current, i, PyLong_FromLong(cm.num_face_vertices[i]));
-      }
-
-      PyDict_SetItemString(meshobj, "num_face_vertices", current);
-    }
-
-    {
-      current = PyList_New(0);
-
-      for (size_t i = 0; i < cm.material_ids.size(); i++) {
-        PyList_Insert(current, i, PyLong_FromLong(cm.material_ids[i]));
-      }
-
-      PyDict_SetItemString(meshobj, "material_ids", current);
-    }
-
-    PyDict_SetItemString(pyshapes, (*shape).name.c_str(), meshobj);
+    const tinyobj::mesh_t& cm = (*shape).mesh;
+
+    setItem(meshobj, "indices",
+            makeArray(owner, cm.indices.data(), cm.indices.size(), 3,
+                      sizeof(int), "i"));
+    setItem(meshobj, "num_face_vertices",
+            makeArray(owner, cm.num_face_vertices.data(),
+                      cm.num_face_vertices.size(), 1, sizeof(unsigned char),
+                      "B"));
+    setItem(meshobj, "material_ids",
+            makeArray(owner, cm.material_ids.data(), cm.material_ids.size(), 1,
+                      sizeof(int), "i"));
+
+    setItem(pyshapes, (*shape).name.c_str(), meshobj);
   }
 
-  for (std::vector<tinyobj::material_t>::iterator mat = materials.begin();
-       mat != materials.end(); mat++) {
+  for (std::vector<tinyobj::material_t>::iterator mat =
+           parsed->materials.begin();
+       mat != parsed->materials.end(); mat++) {
     PyObject* matobj = PyDict_New();
     PyObject* unknown_parameter = PyDict_New();
 
     for (std::map<std::string, std::string>::iterator p =
              (*mat).unknown_parameter.begin();
          p != (*mat).unknown_parameter.end(); ++p) {
-      PyDict_SetItemString(unknown_parameter, p->first.c_str(),
-                           PyUnicode_FromString(p->second.c_str()));
+      setItem(unknown_parameter, p->first.c_str(),
+              PyUnicode_FromString(p->second.c_str()));
     }
 
-    PyDict_SetItemString(matobj, "shininess",
-                         PyFloat_FromDouble((*mat).shininess));
-    PyDict_SetItemString(matobj, "ior", PyFloat_FromDouble((*mat).ior));
-    PyDict_SetItemString(matobj, "dissolve",
-                         PyFloat_FromDouble((*mat).dissolve));
-    PyDict_SetItemString(matobj, "illum", PyLong_FromLong((*mat).illum));
-    PyDict_SetItemString(matobj, "ambient_texname",
-                         PyUnicode_FromString((*mat).ambient_texname.c_str()));
-    PyDict_SetItemString(matobj, "diffuse_texname",
-                         PyUnicode_FromString((*mat).diffuse_texname.c_str()));
-    PyDict_SetItemString(matobj, "specular_texname",
-                         PyUnicode_FromString((*mat).specular_texname.c_str()));
-    PyDict_SetItemString(
-        matobj, "specular_highlight_texname",
-        PyUnicode_FromString((*mat).specular_highlight_texname.c_str()));
-    PyDict_SetItemString(matobj, "bump_texname",
-                         PyUnicode_FromString((*mat).bump_texname.c_str()));
-    PyDict_SetItemString(
-        matobj, "displacement_texname",
-        PyUnicode_FromString((*mat).displacement_texname.c_str()));
-    PyDict_SetItemString(matobj, "alpha_texname",
-                         PyUnicode_FromString((*mat).alpha_texname.c_str()));
-    PyDict_SetItemString(matobj, "ambient", pyTupleFromfloat3((*mat).ambient));
-    PyDict_SetItemString(matobj, "diffuse", pyTupleFromfloat3((*mat).diffuse));
-    PyDict_SetItemString(matobj, "specular",
-                         pyTupleFromfloat3((*mat).specular));
-    PyDict_SetItemString(matobj, "transmittance",
-                         pyTupleFromfloat3((*mat).transmittance));
-    PyDict_SetItemString(matobj, "emission",
-                         pyTupleFromfloat3((*mat).emission));
-    PyDict_SetItemString(matobj, "unknown_parameter", unknown_parameter);
-
-    PyDict_SetItemString(pymaterials, (*mat).name.c_str(), matobj);
+    setItem(matobj, "shininess", PyFloat_FromDouble((*mat).shininess));
+    setItem(matobj, "ior", PyFloat_FromDouble((*mat).ior));
+    setItem(matobj, "dissolve", PyFloat_FromDouble((*mat).dissolve));
+    setItem(matobj, "illum", PyLong_FromLong((*mat).illum));
+    setItem(matobj, "ambient_texname",
+            PyUnicode_FromString((*mat).ambient_texname.c_str()));
+    setItem(matobj, "diffuse_texname",
+            PyUnicode_FromString((*mat).diffuse_texname.c_str()));
+    setItem(matobj, "specular_texname",
+            PyUnicode_FromString((*mat).specular_texname.c_str()));
+    setItem(matobj, "specular_highlight_texname",
+            PyUnicode_FromString((*mat).specular_highlight_texname.c_str()));
+    setItem(matobj, "bump_texname",
+            PyUnicode_FromString((*mat).bump_texname.c_str()));
+    setItem(matobj, "displacement_texname",
+            PyUnicode_FromString((*mat).displacement_texname.c_str()));
+    setItem(matobj, "alpha_texname",
+            PyUnicode_FromString((*mat).alpha_texname.c_str()));
+    setItem(matobj, "ambient", pyTupleFromfloat3((*mat).ambient));
+    setItem(matobj, "diffuse", pyTupleFromfloat3((*mat).diffuse));
+    setItem(matobj, "specular", pyTupleFromfloat3((*mat).specular));
+    setItem(matobj, "transmittance", pyTupleFromfloat3((*mat).transmittance));
+    setItem(matobj, "emission", pyTupleFromfloat3((*mat).emission));
+    setItem(matobj, "unknown_parameter", unknown_parameter);
+
+    setItem(pymaterials, (*mat).name.c_str(), matobj);
   }
 
-  PyDict_SetItemString(rtndict, "shapes", pyshapes);
-  PyDict_SetItemString(rtndict, "materials", pymaterials);
+  Py_DECREF(owner);
+
+  setItem(rtndict, "attrib", attribobj);
+  setItem(rtndict, "shapes", pyshapes);
+  setItem(rtndict, "materials", pymaterials);
 
   return rtndict;
 }
@@ -186,6 +238,22 @@ static struct PyModuleDef moduledef = {PyModuleDef_HEAD_INIT, "tinyobjloader",
                                        NULL, -1, mMethods};
 
 PyMODINIT_FUNC PyInit_tinyobjloader(void) {
+  ArrayViewBuffer.bf_getbuffer = ArrayView_getbuffer;
+  ArrayViewType.tp_name = "tinyobjloader.ArrayView";
+  ArrayViewType.tp_basicsize = sizeof(ArrayView);
+  ArrayViewType.tp_dealloc = ArrayView_dealloc;
+  ArrayViewType.tp_as_buffer = &ArrayViewBuffer;
+  ArrayViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+  if (PyType_Ready(&ArrayViewType) < 0) return NULL;
+
+  // NumPy is optional, without it the arrays come back as memoryviews
+  PyObject* numpy = PyImport_ImportModule("numpy");
+  if (numpy != NULL) {
+    numpyAsarray = PyObject_GetAttrString(numpy, "asarray");
+    Py_DECREF(numpy);
+  }
+  PyErr_Clear();
+
   return PyModule_Create(&moduledef);
 }
 }
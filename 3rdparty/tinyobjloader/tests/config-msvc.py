@@ -19,9 +19,9 @@ includes = {
     }
 
 defines = {
-    "gnu" : [ "-DEXAMPLE=1" ]
-  , "msvc" : [ "/DEXAMPLE=1" ]
-  , "clang" : [ "-DEXAMPLE=1" ]
+    "gnu" : [ "-DEXAMPLE=1", "-DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
+  , "msvc" : [ "/DEXAMPLE=1", "/DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
+  , "clang" : [ "-DEXAMPLE=1", "-DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
     }
 
 cflags = {
@@ -43,7 +43,7 @@ ldflags = {
     }
 
 # optionsl
-cxx_files = [ "tester.cc" ]
+cxx_files = [ "tester.cc", "../experimental/ltalloc.cc" ]
 c_files = [ ]
 
 # You can register your own toolchain through register_toolchain function
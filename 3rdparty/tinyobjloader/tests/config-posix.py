@@ -20,9 +20,9 @@ includes = {
     }
 
 defines = {
-    "gnu" : [ ]
-  , "msvc" : [ ]
-  , "clang" : [  ]
+    "gnu" : [ "-DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
+  , "msvc" : [ "/DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
+  , "clang" : [ "-DLTALLOC_DISABLE_OPERATOR_NEW_OVERRIDE" ]
     }
 
 cflags = {
@@ -39,12 +39,12 @@ cxxflags = {
     }
 
 ldflags = {
-    "gnu" : [ "-fsanitize=address" ]
+    "gnu" : [ "-fsanitize=address", "-pthread" ]
   , "msvc" : [ ]
-  , "clang" : [ "-fsanitize=address" ]
+  , "clang" : [ "-fsanitize=address", "-pthread" ]
     }
 
-cxx_files = [ "tester.cc" ]
+cxx_files = [ "tester.cc", "../experimental/ltalloc.cc" ]
 c_files = [ ]
 
 # You can register your own toolchain through register_toolchain function
@@ -4,6 +4,9 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
 
+#define TINYOBJ_LOADER_OPT_IMPLEMENTATION
+#include "../experimental/tinyobj_loader_opt.h"
+
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
@@ -530,6 +533,247 @@ TEST_CASE("texture_opts", "[Issue85]") {
   REQUIRE(tinyobj::TEXTURE_TYPE_CUBE_BACK == materials[2].displacement_texopt.type);
 }
 
+TEST_CASE("compact_indices", "[Compact]") {
+  std::stringstream objStream;
+  objStream
+    << "v 0 0 0\n"
+       "v 1 0 0\n"
+       "v 0 1 0\n"
+       "v 1 1 0\n"
+       "vt 0 0\n"
+       "o positions\n"
+       "f 1 2 3 4\n"
+       "o mixed\n"
+       "f 1 2 3\n"
+       "f 2/1 3/1 4/1\n";
+
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err;
+  tinyobj::load_options_t options;
+  options.compact_indices = true;
+  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &objStream, NULL, options);
+
+  REQUIRE(true == ret);
+  REQUIRE(2 == shapes.size());
+
+  // Quad is triangulated, only positions are stored
+  const tinyobj::mesh_t &positions = shapes[0].mesh;
+  REQUIRE(0 == positions.indices.size());
+  REQUIRE(0 == positions.attributes);
+  REQUIRE(6 == positions.vertex_indices.size());
+  REQUIRE(0 == positions.normal_indices.size());
+  REQUIRE(0 == positions.texcoord_indices.size());
+  REQUIRE(2 == positions.num_face_vertices.size());
+  REQUIRE(3 == positions.vertex_indices[5]);
+
+  // Texcoords show up in the second face, the first one gets -1
+  const tinyobj::mesh_t &mixed = shapes[1].mesh;
+  REQUIRE(tinyobj::MESH_HAS_TEXCOORDS == mixed.attributes);
+  REQUIRE(6 == mixed.vertex_indices.size());
+  REQUIRE(6 == mixed.texcoord_indices.size());
+  REQUIRE(-1 == mixed.texcoord_indices[2]);
+  REQUIRE(0 == mixed.texcoord_indices[3]);
+  REQUIRE(0 == mixed.normal_indices.size());
+}
+
+TEST_CASE("skip_attributes", "[LoadOptions]") {
+  std::stringstream objStream;
+  objStream
+    << "v 0 0 0\n"
+       "v 1 0 0\n"
+       "v 0 1 0\n"
+       "vn 0 0 1\n"
+       "vt 0 0\n"
+       "vp 0.5 0.5\n"
+       "t crease 2/1/0 1 2 4.5\n"
+       "f 1/1/1 2/1/1 3/1/1\n";
+
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err;
+  tinyobj::load_options_t options;
+  options.load_normals = false;
+  options.load_tags = false;
+  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &objStream, NULL, options);
+
+  REQUIRE(true == ret);
+  REQUIRE(9 == attrib.vertices.size());
+  REQUIRE(0 == attrib.normals.size());
+  REQUIRE(2 == attrib.texcoords.size());
+  REQUIRE(1 == shapes.size());
+  REQUIRE(0 == shapes[0].mesh.tags.size());
+  REQUIRE(tinyobj::MESH_HAS_TEXCOORDS == shapes[0].mesh.attributes);
+  REQUIRE(-1 == shapes[0].mesh.indices[0].normal_index);
+  REQUIRE(0 == shapes[0].mesh.indices[0].texcoord_index);
+}
+
+// Parses `obj` with the opt loader, `chunk_size` 0 meaning a single chunk.
+static void ParseOpt(const std::string &obj, int num_threads, size_t chunk_size,
+                     tinyobj_opt::attrib_t *attrib,
+                     std::vector<tinyobj_opt::shape_t> *shapes) {
+  std::vector<tinyobj_opt::material_t> materials;
+  tinyobj_opt::LoadOption option;
+  option.req_num_threads = num_threads;
+  option.chunk_size = chunk_size > 0 ? chunk_size : obj.size();
+  bool ret = tinyobj_opt::parseObj(attrib, shapes, &materials, obj.data(),
+                                   obj.size(), option);
+  REQUIRE(true == ret);
+  REQUIRE(2 == materials.size());
+}
+
+TEST_CASE("opt_loader_chunks", "[OptLoader]") {
+  {
+    std::ofstream mtl("opt_loader_chunks.mtl");
+    mtl << "newmtl red\nKd 1 0 0\nnewmtl green\nKd 0 1 0\n";
+  }
+
+  // Every line is a chunk of its own with chunk_size 1, so shapes, relative
+  // indices and usemtl all have to carry over from earlier chunks.
+  std::stringstream objStream;
+  objStream << "mtllib opt_loader_chunks.mtl\n"
+               "# faces before the first o/g line\n"
+               "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+               "vt 0 0\nvt 1 0\nvt 0 1\n"
+               "vn 0 0 1\n"
+               "f 1 2 3\n";
+  for (int i = 0; i < 40; i++) {
+    objStream << (i % 3 == 0 ? "g group" : "o object") << i << "\r\n";
+    if (i % 4 == 0) objStream << "usemtl " << (i % 8 == 0 ? "red" : "green") << "\n";
+    if (i % 5 == 0) objStream << "usemtl missing\n";
+    objStream << "v " << i << " 0 1\nv " << i << " 1 1\nv " << i << " 1 2\n"
+              << "vt 0.5 " << i << "\n\n";
+    for (int j = 0; j < (i % 3); j++) {
+      objStream << "f -3/-1/1 -2/-1/1 -1/-1/1\n"
+                   "f 1/1 2/2 4/3 3/3\n";
+    }
+  }
+  objStream << "f 1//1 2//1 3//1";
+  std::string obj = objStream.str();
+
+  tinyobj_opt::attrib_t expected;
+  std::vector<tinyobj_opt::shape_t> expected_shapes;
+  ParseOpt(obj, 1, 0, &expected, &expected_shapes);
+  REQUIRE(0 < expected_shapes.size());
+
+  // The first face comes before any usemtl and o/g line
+  REQUIRE(-1 == expected.material_ids[0]);
+  REQUIRE("" == expected_shapes[0].name);
+  REQUIRE(1 == expected_shapes[0].length);
+
+  const int thread_counts[] = {1, 2, 3, 8};
+  const size_t chunk_sizes[] = {1, 7, 64};
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+      tinyobj_opt::attrib_t attrib;
+      std::vector<tinyobj_opt::shape_t> shapes;
+      ParseOpt(obj, thread_counts[t], chunk_sizes[c], &attrib, &shapes);
+
+      REQUIRE(expected.vertices == attrib.vertices);
+      REQUIRE(expected.normals == attrib.normals);
+      REQUIRE(expected.texcoords == attrib.texcoords);
+      REQUIRE(expected.face_num_verts == attrib.face_num_verts);
+      REQUIRE(expected.material_ids == attrib.material_ids);
+      REQUIRE(expected.indices.size() == attrib.indices.size());
+      for (size_t i = 0; i < attrib.indices.size(); i++) {
+        REQUIRE(expected.indices[i].vertex_index == attrib.indices[i].vertex_index);
+        REQUIRE(expected.indices[i].texcoord_index == attrib.indices[i].texcoord_index);
+        REQUIRE(expected.indices[i].normal_index == attrib.indices[i].normal_index);
+      }
+      REQUIRE(expected_shapes.size() == shapes.size());
+      for (size_t i = 0; i < shapes.size(); i++) {
+        REQUIRE(expected_shapes[i].name == shapes[i].name);
+        REQUIRE(expected_shapes[i].face_offset == shapes[i].face_offset);
+        REQUIRE(expected_shapes[i].length == shapes[i].length);
+      }
+    }
+  }
+
+  std::remove("opt_loader_chunks.mtl");
+}
+
+// Serves the same block of obj text over and over, so huge objs can be parsed
+// without ever being in memory or on disk.
+class SyntheticObjBuffer : public std::streambuf {
+ public:
+  SyntheticObjBuffer(const std::string &block, unsigned long long total)
+      : block_(block), left_(total), served_(0) {}
+
+  unsigned long long served() const { return served_; }
+
+ protected:
+  virtual int_type underflow() {
+    if (left_ < block_.size()) return traits_type::eof();
+    left_ -= block_.size();
+    served_ += block_.size();
+    char *begin = &block_[0];
+    setg(begin, begin, begin + block_.size());
+    return traits_type::to_int_type(*begin);
+  }
+
+ private:
+  std::string block_;
+  unsigned long long left_;
+  unsigned long long served_;
+};
+
+struct SyntheticObjCounts {
+  unsigned long long vertices;
+  unsigned long long faces;
+  unsigned long long bad;
+};
+
+static void countVertex(void *user_data, float x, float, float, float) {
+  SyntheticObjCounts *counts = static_cast<SyntheticObjCounts *>(user_data);
+  counts->vertices++;
+  if (x != 1000.25f) counts->bad++;
+}
+
+static void countFace(void *user_data, tinyobj::index_t *indices,
+                      int num_indices) {
+  SyntheticObjCounts *counts = static_cast<SyntheticObjCounts *>(user_data);
+  counts->faces++;
+  if (num_indices != 3 || indices[0].vertex_index != -3 ||
+      indices[2].vertex_index != -1)
+    counts->bad++;
+}
+
+// Streams `total` bytes of a triangle soup through the callback loader and
+// checks that every vertex and face arrives intact.
+static void StreamSyntheticObj(unsigned long long total) {
+  const std::string block =
+      "v 1000.25 2000.5 3000.75\n"
+      "v 1000.25 2000.5 3000.75\n"
+      "v 1000.25 2000.5 3000.75\n"
+      "f -3 -2 -1\n";
+  SyntheticObjBuffer buffer(block, total);
+  std::istream objStream(&buffer);
+
+  SyntheticObjCounts counts = SyntheticObjCounts();
+  tinyobj::callback_t callback;
+  callback.vertex_cb = countVertex;
+  callback.index_cb = countFace;
+  bool ret = tinyobj::LoadObjWithCallback(objStream, callback, &counts);
+
+  unsigned long long blocks = total / block.size();
+  REQUIRE(true == ret);
+  REQUIRE(blocks * block.size() == buffer.served());
+  REQUIRE(blocks * 3 == counts.vertices);
+  REQUIRE(blocks == counts.faces);
+  REQUIRE(0 == counts.bad);
+}
+
+TEST_CASE("stream_synthetic_obj", "[Stream]") {
+  StreamSyntheticObj(1ull << 20);
+}
+
+// Hidden, takes a while: run with `./tester "[LargeFile]"`
+TEST_CASE("stream_synthetic_obj_over_4gb", "[.][LargeFile]") {
+  StreamSyntheticObj((1ull << 32) + (1ull << 28));
+}
+
 #if 0
 int
 main(
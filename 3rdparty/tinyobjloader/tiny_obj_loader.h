@@ -197,6 +197,12 @@ typedef struct {
   int texcoord_index;
 } index_t;
 
+// Attributes referenced by the indices of a shape. See `mesh_t::attributes`.
+enum {
+  MESH_HAS_NORMALS = 1,
+  MESH_HAS_TEXCOORDS = 2
+};
+
 typedef struct {
   std::vector<index_t> indices;
   std::vector<unsigned char> num_face_vertices;  // The number of vertices per
@@ -204,6 +210,16 @@ typedef struct {
                                                  // ... Up to 255.
   std::vector<int> material_ids;                 // per-face material ID
   std::vector<tag_t> tags;                       // SubD tag
+
+  // Filled instead of `indices` when loading with
+  // `load_options_t::compact_indices`. `vertex_indices` has an entry per
+  // index. `normal_indices` and `texcoord_indices` are only filled (with -1
+  // for unused) when `attributes` has MESH_HAS_NORMALS / MESH_HAS_TEXCOORDS
+  // set, and are empty otherwise.
+  std::vector<int> vertex_indices;
+  std::vector<int> normal_indices;
+  std::vector<int> texcoord_indices;
+  int attributes;  // MESH_HAS_* flags, set in both layouts
 } mesh_t;
 
 typedef struct {
@@ -253,6 +269,28 @@ typedef struct callback_t_ {
         object_cb(NULL) {}
 } callback_t;
 
+typedef struct load_options_t_ {
+  // Triangulate polygon faces.
+  bool triangulate;
+  // Store 4 byte indices per attribute in `mesh_t::vertex_indices`,
+  // `normal_indices` and `texcoord_indices` instead of 12 byte `index_t`s in
+  // `mesh_t::indices`, leaving out attributes a shape never uses.
+  bool compact_indices;
+  // Attributes to materialise. Lines of skipped attributes are stepped over
+  // without parsing their values, and face indices into them become -1.
+  // `vp` lines are never stored.
+  bool load_normals;    // 'vn'
+  bool load_texcoords;  // 'vt'
+  bool load_tags;       // 't'
+
+  load_options_t_()
+      : triangulate(true),
+        compact_indices(false),
+        load_normals(true),
+        load_texcoords(true),
+        load_tags(true) {}
+} load_options_t;
+
 class MaterialReader {
  public:
   MaterialReader() {}
@@ -323,6 +361,14 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              std::istream *inStream, MaterialReader *readMatFn = NULL,
              bool triangulate = true);
 
+/// Loads object from a std::istream with the given options.
+/// Returns true when loading .obj become success.
+/// Returns warning and error message into `err`
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *err,
+             std::istream *inStream, MaterialReader *readMatFn,
+             const load_options_t &options);
+
 /// Loads materials into std::map
 void LoadMtl(std::map<std::string, int> *material_map,
              std::vector<material_t> *materials, std::istream *inStream);
@@ -871,14 +917,45 @@ static void InitMaterial(material_t *material) {
   material->unknown_parameter.clear();
 }
 
+// Appends one index to the mesh in the layout the options ask for.
+static void pushIndex(mesh_t *mesh, const vertex_index &vi, bool compact) {
+  if (vi.vn_idx >= 0 && !(mesh->attributes & MESH_HAS_NORMALS)) {
+    mesh->attributes |= MESH_HAS_NORMALS;
+    if (compact) mesh->normal_indices.assign(mesh->vertex_indices.size(), -1);
+  }
+  if (vi.vt_idx >= 0 && !(mesh->attributes & MESH_HAS_TEXCOORDS)) {
+    mesh->attributes |= MESH_HAS_TEXCOORDS;
+    if (compact)
+      mesh->texcoord_indices.assign(mesh->vertex_indices.size(), -1);
+  }
+
+  if (!compact) {
+    index_t idx;
+    idx.vertex_index = vi.v_idx;
+    idx.normal_index = vi.vn_idx;
+    idx.texcoord_index = vi.vt_idx;
+    mesh->indices.push_back(idx);
+    return;
+  }
+
+  mesh->vertex_indices.push_back(vi.v_idx);
+  if (mesh->attributes & MESH_HAS_NORMALS)
+    mesh->normal_indices.push_back(vi.vn_idx);
+  if (mesh->attributes & MESH_HAS_TEXCOORDS)
+    mesh->texcoord_indices.push_back(vi.vt_idx);
+}
+
 static bool exportFaceGroupToShape(
     shape_t *shape, const std::vector<std::vector<vertex_index> > &faceGroup,
     const std::vector<tag_t> &tags, const int material_id,
-    const std::string &name, bool triangulate) {
+    const std::string &name, const load_options_t &options) {
   if (faceGroup.empty()) {
     return false;
   }
 
+  bool triangulate = options.triangulate;
+  bool compact = options.compact_indices;
+
   // Flatten vertices and indices
   for (size_t i = 0; i < faceGroup.size(); i++) {
     const std::vector<vertex_index> &face = faceGroup[i];
@@ -895,31 +972,16 @@ static bool exportFaceGroupToShape(
         i1 = i2;
         i2 = face[k];
 
-        index_t idx0, idx1, idx2;
-        idx0.vertex_index = i0.v_idx;
-        idx0.normal_index = i0.vn_idx;
-        idx0.texcoord_index = i0.vt_idx;
-        idx1.vertex_index = i1.v_idx;
-        idx1.normal_index = i1.vn_idx;
-        idx1.texcoord_index = i1.vt_idx;
-        idx2.vertex_index = i2.v_idx;
-        idx2.normal_index = i2.vn_idx;
-        idx2.texcoord_index = i2.vt_idx;
-
-        shape->mesh.indices.push_back(idx0);
-        shape->mesh.indices.push_back(idx1);
-        shape->mesh.indices.push_back(idx2);
+        pushIndex(&shape->mesh, i0, compact);
+        pushIndex(&shape->mesh, i1, compact);
+        pushIndex(&shape->mesh, i2, compact);
 
         shape->mesh.num_face_vertices.push_back(3);
         shape->mesh.material_ids.push_back(material_id);
       }
     } else {
       for (size_t k = 0; k < npolys; k++) {
-        index_t idx;
-        idx.vertex_index = face[k].v_idx;
-        idx.normal_index = face[k].vn_idx;
-        idx.texcoord_index = face[k].vt_idx;
-        shape->mesh.indices.push_back(idx);
+        pushIndex(&shape->mesh, face[k], compact);
       }
 
       shape->mesh.num_face_vertices.push_back(
@@ -1349,6 +1411,15 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
              std::vector<material_t> *materials, std::string *err,
              std::istream *inStream, MaterialReader *readMatFn /*= NULL*/,
              bool triangulate) {
+  load_options_t options;
+  options.triangulate = triangulate;
+  return LoadObj(attrib, shapes, materials, err, inStream, readMatFn, options);
+}
+
+bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
+             std::vector<material_t> *materials, std::string *err,
+             std::istream *inStream, MaterialReader *readMatFn,
+             const load_options_t &options) {
   std::stringstream errss;
 
   std::vector<float> v;
@@ -1362,7 +1433,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   std::map<std::string, int> material_map;
   int material = -1;
 
-  shape_t shape;
+  shape_t shape = shape_t();
 
   std::string linebuf;
   while (inStream->peek() != -1) {
@@ -1405,6 +1476,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
     // normal
     if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2]))) {
+      if (!options.load_normals) continue;
       token += 3;
       float x, y, z;
       parseFloat3(&x, &y, &z, &token);
@@ -1416,6 +1488,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
 
     // texcoord
     if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2]))) {
+      if (!options.load_texcoords) continue;
       token += 3;
       float x, y;
       parseFloat2(&x, &y, &token);
@@ -1436,6 +1509,8 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         vertex_index vi = parseTriple(&token, static_cast<int>(v.size() / 3),
                                       static_cast<int>(vn.size() / 3),
                                       static_cast<int>(vt.size() / 2));
+        if (!options.load_normals) vi.vn_idx = -1;
+        if (!options.load_texcoords) vi.vt_idx = -1;
         face.push_back(vi);
         size_t n = strspn(token, " \t\r");
         token += n;
@@ -1470,7 +1545,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
         // this time.
         // just clear `faceGroup` after `exportFaceGroupToShape()` call.
         exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                               triangulate);
+                               options);
         faceGroup.clear();
         material = newMaterialId;
       }
@@ -1508,7 +1583,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 'g' && IS_SPACE((token[1]))) {
       // flush previous face group.
       bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                        triangulate);
+                                        options);
       if (ret) {
         shapes->push_back(shape);
       }
@@ -1543,7 +1618,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     if (token[0] == 'o' && IS_SPACE((token[1]))) {
       // flush previous face group.
       bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                        triangulate);
+                                        options);
       if (ret) {
         shapes->push_back(shape);
       }
@@ -1566,6 +1641,7 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
     }
 
     if (token[0] == 't' && IS_SPACE(token[1])) {
+      if (!options.load_tags) continue;
       tag_t tag;
 
       char namebuf[4096];
@@ -1615,12 +1691,12 @@ bool LoadObj(attrib_t *attrib, std::vector<shape_t> *shapes,
   }
 
   bool ret = exportFaceGroupToShape(&shape, faceGroup, tags, material, name,
-                                    triangulate);
+                                    options);
   // exportFaceGroupToShape return false when `usemtl` is called in the last
   // line.
   // we also add `shape` to `shapes` when `shape.mesh` has already some
   // faces(indices)
-  if (ret || shape.mesh.indices.size()) {
+  if (ret || shape.mesh.indices.size() || shape.mesh.vertex_indices.size()) {
     shapes->push_back(shape);
   }
   faceGroup.clear();  // for safety
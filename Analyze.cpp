@@ -0,0 +1,256 @@
+#include "Analyze.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <istream>
+#include <streambuf>
+#include <dif/base/io.h>
+#include <dif/objects/dif.h>
+
+// Read-only stream over a file already in memory, so parsing is timed without the disk
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+	MemoryStreamBuffer(const char* data, size_t size)
+	{
+		char* begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+
+protected:
+	virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+	{
+		off_type base = 0;
+		if (dir == std::ios_base::cur)
+			base = gptr() - eback();
+		else if (dir == std::ios_base::end)
+			base = egptr() - eback();
+		return seekpos(pos_type(base + off), which);
+	}
+
+	virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which)
+	{
+		if (!(which & std::ios_base::in) || off_type(pos) < 0 || off_type(pos) > egptr() - eback())
+			return pos_type(off_type(-1));
+		setg(eback(), eback() + off_type(pos), egptr());
+		return pos;
+	}
+};
+
+struct BspStats
+{
+	int nodes;
+	int leaves;
+	int solidLeaves;
+	int maxDepth;
+	double averageDepth;
+};
+
+struct DifStats
+{
+	std::string path;
+	size_t size;
+	int interiors;
+	int subObjects;
+	int surfaces;
+	int planes;
+	int hulls;
+	int points;
+	BspStats bsp;
+	glm::vec3 min, max;
+	double diskMs;
+	double parseMs;
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool readFile(const std::string& path, std::vector<char>& data)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (f == NULL)
+		return false;
+
+	data.clear();
+	char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
+
+static bool parseDif(const std::vector<char>& data, DIF::DIF& dif)
+{
+	MemoryStreamBuffer buffer(data.data(), data.size());
+	std::istream stream(&buffer);
+	DIF::Version version;
+	return dif.read(stream, version);
+}
+
+// Walks the tree from the root node. Leaf children count as leaves at one deeper than their node,
+// broken indices and nodes reached twice are not followed.
+static void addBspStats(const DIF::Interior& interior, BspStats& stats, double& depthSum)
+{
+	if (interior.bspNode.empty())
+		return;
+
+	std::vector<bool> visited(interior.bspNode.size(), false);
+	std::vector<std::pair<size_t, int> > stack;
+	stack.push_back(std::make_pair((size_t)0, 1));
+	while (!stack.empty())
+	{
+		size_t index = stack.back().first;
+		int depth = stack.back().second;
+		stack.pop_back();
+		if (index >= interior.bspNode.size() || visited[index])
+			continue;
+		visited[index] = true;
+		stats.nodes++;
+
+		const DIF::BSPNode& node = interior.bspNode[index];
+		const bool leaf[2] = { node.isFrontLeaf, node.isBackLeaf };
+		const bool solid[2] = { node.isFrontSolid, node.isBackSolid };
+		const size_t child[2] = { node.frontIndex, node.backIndex };
+		for (int i = 0; i < 2; i++)
+		{
+			if (!leaf[i])
+			{
+				stack.push_back(std::make_pair(child[i], depth + 1));
+				continue;
+			}
+			stats.leaves++;
+			if (solid[i])
+				stats.solidLeaves++;
+			stats.maxDepth = std::max(stats.maxDepth, depth + 1);
+			depthSum += depth + 1;
+		}
+	}
+}
+
+static bool analyzeDif(const std::string& path, int iterations, DifStats& stats)
+{
+	stats = DifStats();
+	stats.path = path;
+
+	std::vector<char> data;
+	DIF::DIF dif;
+	auto start = std::chrono::steady_clock::now();
+	if (!readFile(path, data) || !parseDif(data, dif))
+	{
+		printf("Could not read %s\n", path.c_str());
+		return false;
+	}
+	stats.diskMs = millisecondsSince(start);
+	stats.size = data.size();
+
+	// Best of several parses from memory, the first one above also paid for the disk
+	stats.parseMs = stats.diskMs;
+	for (int i = 0; i < iterations; i++)
+	{
+		DIF::DIF copy;
+		start = std::chrono::steady_clock::now();
+		parseDif(data, copy);
+		stats.parseMs = std::min(stats.parseMs, millisecondsSince(start));
+	}
+
+	stats.interiors = dif.interior.size();
+	stats.subObjects = dif.subObject.size();
+	stats.min = glm::vec3(INFINITY);
+	stats.max = glm::vec3(-INFINITY);
+	double depthSum = 0;
+	for (const DIF::Interior& interior : dif.interior)
+	{
+		stats.surfaces += interior.surface.size();
+		stats.planes += interior.plane.size();
+		stats.hulls += interior.convexHull.size();
+		stats.points += interior.point.size();
+		addBspStats(interior, stats.bsp, depthSum);
+		for (const glm::vec3& point : interior.point)
+		{
+			stats.min = glm::min(stats.min, point);
+			stats.max = glm::max(stats.max, point);
+		}
+	}
+	if (stats.bsp.leaves > 0)
+		stats.bsp.averageDepth = depthSum / stats.bsp.leaves;
+	return true;
+}
+
+static double boxVolume(const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+	return (double)extent.x * extent.y * extent.z;
+}
+
+int analyzeDifs(const std::vector<std::string>& paths, int iterations)
+{
+	std::vector<DifStats> difs;
+	for (const std::string& path : paths)
+	{
+		DifStats stats;
+		if (!analyzeDif(path, iterations, stats))
+			return 1;
+		difs.push_back(stats);
+	}
+
+	DifStats total = DifStats();
+	double parseMs = 0;
+	for (const DifStats& dif : difs)
+	{
+		// A perfectly balanced tree reaches every leaf in log2(leaves) steps
+		int balancedDepth = dif.bsp.leaves > 1 ? (int)ceil(log2((double)dif.bsp.leaves)) : dif.bsp.leaves;
+		printf("%s: %llu bytes, %d interior%s, %d subobject%s\n", dif.path.c_str(), (unsigned long long)dif.size, dif.interiors, dif.interiors == 1 ? "" : "s", dif.subObjects, dif.subObjects == 1 ? "" : "s");
+		printf("  %d surfaces, %d planes, %d points, %d hulls\n", dif.surfaces, dif.planes, dif.points, dif.hulls);
+		printf("  bsp: %d nodes, %d leaves (%d solid), depth %d, average leaf depth %.1f, balanced depth %d\n", dif.bsp.nodes, dif.bsp.leaves, dif.bsp.solidLeaves, dif.bsp.maxDepth, dif.bsp.averageDepth, balancedDepth);
+		if (dif.points > 0)
+			printf("  bounds: (%g %g %g) - (%g %g %g)\n", dif.min.x, dif.min.y, dif.min.z, dif.max.x, dif.max.y, dif.max.z);
+		printf("  read back: %.3f ms from disk, %.3f ms parse\n", dif.diskMs, dif.parseMs);
+
+		total.size += dif.size;
+		total.surfaces += dif.surfaces;
+		total.planes += dif.planes;
+		total.hulls += dif.hulls;
+		total.bsp.nodes += dif.bsp.nodes;
+		total.bsp.leaves += dif.bsp.leaves;
+		total.bsp.maxDepth = std::max(total.bsp.maxDepth, dif.bsp.maxDepth);
+		parseMs += dif.parseMs;
+	}
+
+	if (difs.size() < 2)
+		return 0;
+
+	printf("Total: %d difs, %llu bytes, %d surfaces, %d planes, %d hulls, %d bsp nodes, %d leaves, deepest bsp %d, %.3f ms parse\n", (int)difs.size(), (unsigned long long)total.size, total.surfaces, total.planes, total.hulls, total.bsp.nodes, total.bsp.leaves, total.bsp.maxDepth, parseMs);
+
+	// Every point in an overlap is in the bounds of more than one chunk, so collision checks there
+	// test all of them
+	double volume = 0;
+	double overlapVolume = 0;
+	int overlaps = 0;
+	for (size_t i = 0; i < difs.size(); i++)
+	{
+		if (difs[i].points == 0)
+			continue;
+		volume += boxVolume(difs[i].min, difs[i].max);
+		for (size_t j = i + 1; j < difs.size(); j++)
+		{
+			if (difs[j].points == 0)
+				continue;
+			glm::vec3 min = glm::max(difs[i].min, difs[j].min);
+			glm::vec3 max = glm::min(difs[i].max, difs[j].max);
+			if (min.x > max.x || min.y > max.y || min.z > max.z)
+				continue;
+			double shared = boxVolume(min, max);
+			double smaller = std::min(boxVolume(difs[i].min, difs[i].max), boxVolume(difs[j].min, difs[j].max));
+			printf("  %s and %s overlap: %.1f%% of the smaller bounds\n", difs[i].path.c_str(), difs[j].path.c_str(), smaller > 0 ? 100.0 * shared / smaller : 100.0);
+			overlapVolume += shared;
+			overlaps++;
+		}
+	}
+	printf("Chunk bounds overlap: %d pair%s, %.1f%% of the total chunk volume\n", overlaps, overlaps == 1 ? "" : "s", volume > 0 ? 100.0 * overlapVolume / volume : 0.0);
+	return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Number of times each dif is parsed from memory to time the read-back
+#define ANALYZE_READ_ITERATIONS 10
+
+// Reads the difs back and prints their bsp depth and balance, node, leaf, surface, plane and hull
+// counts, size and read-back time, then how much the bounds of the chunks overlap each other
+int analyzeDifs(const std::vector<std::string>& paths, int iterations);
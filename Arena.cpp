@@ -0,0 +1,61 @@
+#include "Arena.hpp"
+#include <stdint.h>
+#include <cstdlib>
+#include <new>
+
+Arena::Arena(size_t blockSize) : mBlockSize(blockSize > 0 ? blockSize : 1)
+{
+}
+
+Arena::~Arena()
+{
+	release();
+}
+
+void* Arena::allocate(size_t size, size_t align)
+{
+	if (!mBlocks.empty())
+	{
+		Block& block = mBlocks.back();
+		size_t start = (block.used + align - 1) & ~(align - 1);
+		if (start + size <= block.size)
+		{
+			block.used = start + size;
+			return block.data + start;
+		}
+	}
+
+	// Oversized requests get a block of their own so the next one still has room
+	Block block;
+	block.size = (size > mBlockSize ? size : mBlockSize);
+	block.data = static_cast<char*>(malloc(block.size));
+	if (block.data == NULL)
+		throw std::bad_alloc();
+	block.used = size;
+	mBlocks.push_back(block);
+	return block.data;
+}
+
+void Arena::deallocate(void* ptr, size_t size)
+{
+	if (mBlocks.empty())
+		return;
+	Block& block = mBlocks.back();
+	if (static_cast<char*>(ptr) + size == block.data + block.used)
+		block.used -= size;
+}
+
+void Arena::release()
+{
+	for (Block& block : mBlocks)
+		free(block.data);
+	mBlocks.clear();
+}
+
+size_t Arena::used() const
+{
+	size_t total = 0;
+	for (const Block& block : mBlocks)
+		total += block.used;
+	return total;
+}
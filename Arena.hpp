@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Bump allocator for data that lives exactly as long as one chunk. Nothing is freed on its own,
+// the whole arena goes away in one go once the chunk is done.
+class Arena
+{
+public:
+	explicit Arena(size_t blockSize = 1 << 20);
+	~Arena();
+
+	void* allocate(size_t size, size_t align);
+	// Only the most recent allocation is given back, which is enough for a vector growing at the end
+	void deallocate(void* ptr, size_t size);
+	void release();
+	size_t used() const;
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+		size_t used;
+	};
+
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	std::vector<Block> mBlocks;
+	size_t mBlockSize;
+};
+
+// Lets standard containers draw from an arena
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena* arena) : mArena(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.arena()) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(mArena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T* ptr, size_t count) { mArena->deallocate(ptr, count * sizeof(T)); }
+
+	Arena* arena() const { return mArena; }
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.arena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return mArena != other.arena(); }
+
+private:
+	Arena* mArena;
+};
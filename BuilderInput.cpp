@@ -0,0 +1,200 @@
+#include "BuilderInput.hpp"
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+
+void storeTriangle(const DIF::DIFBuilder::Triangle& triangle, size_t index, float* positions, float* normals, float* uvs)
+{
+	float* position = positions + index * TRIANGLE_POSITION_FLOATS;
+	float* normal = normals + index * TRIANGLE_NORMAL_FLOATS;
+	float* uv = uvs + index * TRIANGLE_UV_FLOATS;
+	for (int j = 0; j < 3; j++)
+	{
+		const DIF::DIFBuilder::Point& point = triangle.points[j];
+		position[j * 3 + 0] = point.vertex.x;
+		position[j * 3 + 1] = point.vertex.y;
+		position[j * 3 + 2] = point.vertex.z;
+		normal[j * 3 + 0] = point.normal.x;
+		normal[j * 3 + 1] = point.normal.y;
+		normal[j * 3 + 2] = point.normal.z;
+		uv[j * 2 + 0] = point.uv.x;
+		uv[j * 2 + 1] = point.uv.y;
+	}
+}
+
+void addTriangles(DIF::DIFBuilder& builder, size_t count, const float* positions, const float* normals, const float* uvs, const int* materials, const std::vector<std::string>& materialNames)
+{
+	// One triangle is reused for the whole batch, zeroed once so padding stays deterministic
+	DIF::DIFBuilder::Triangle triangle;
+	memset(&triangle, 0, sizeof(triangle));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* position = positions + i * TRIANGLE_POSITION_FLOATS;
+		const float* normal = normals + i * TRIANGLE_NORMAL_FLOATS;
+		const float* uv = uvs + i * TRIANGLE_UV_FLOATS;
+		for (int j = 0; j < 3; j++)
+		{
+			DIF::DIFBuilder::Point& point = triangle.points[j];
+			point.vertex = glm::vec3(position[j * 3 + 0], position[j * 3 + 1], position[j * 3 + 2]);
+			point.normal = glm::vec3(normal[j * 3 + 0], normal[j * 3 + 1], normal[j * 3 + 2]);
+			point.uv = glm::vec2(uv[j * 2 + 0], uv[j * 2 + 1]);
+		}
+		builder.addTriangle(triangle, materialNames[materials[i]]);
+	}
+}
+
+// Spreads the low 10 bits of v out to every third bit
+static uint32_t spreadBits(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Moves the items of each triangle to where order puts them
+template <typename T>
+static void permute(T* items, size_t stride, const std::vector<std::pair<uint64_t, size_t>>& order)
+{
+	std::vector<T> sorted(order.size() * stride);
+	for (size_t i = 0; i < order.size(); i++)
+		memcpy(&sorted[i * stride], items + order[i].second * stride, stride * sizeof(T));
+	memcpy(items, sorted.data(), sorted.size() * sizeof(T));
+}
+
+void sortTrianglesByMaterial(size_t count, float* positions, float* normals, float* uvs, int* materials, const std::vector<int>& textureIds)
+{
+	if (count < 2)
+		return;
+
+	// Centroids are placed on a 1024^3 grid over their bounds
+	float centroids[3];
+	float lo[3] = { 0, 0, 0 };
+	float hi[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* position = positions + i * TRIANGLE_POSITION_FLOATS;
+		for (int k = 0; k < 3; k++)
+		{
+			centroids[k] = (position[k] + position[3 + k] + position[6 + k]) / 3.0f;
+			lo[k] = (i == 0 ? centroids[k] : std::min(lo[k], centroids[k]));
+			hi[k] = (i == 0 ? centroids[k] : std::max(hi[k], centroids[k]));
+		}
+	}
+
+	// Texture in the high half of the key, Morton code in the low half, the index breaks ties so
+	// the order is the same on every platform
+	std::vector<std::pair<uint64_t, size_t>> order(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* position = positions + i * TRIANGLE_POSITION_FLOATS;
+		uint32_t cell[3];
+		for (int k = 0; k < 3; k++)
+		{
+			float centroid = (position[k] + position[3 + k] + position[6 + k]) / 3.0f;
+			float extent = hi[k] - lo[k];
+			cell[k] = (extent > 0 ? (uint32_t)((centroid - lo[k]) / extent * 1023.0f) : 0);
+		}
+		uint32_t morton = spreadBits(cell[0]) | (spreadBits(cell[1]) << 1) | (spreadBits(cell[2]) << 2);
+		order[i] = std::make_pair(((uint64_t)(uint32_t)textureIds[materials[i]] << 32) | morton, i);
+	}
+	std::sort(order.begin(), order.end());
+
+	permute(positions, TRIANGLE_POSITION_FLOATS, order);
+	permute(normals, TRIANGLE_NORMAL_FLOATS, order);
+	permute(uvs, TRIANGLE_UV_FLOATS, order);
+	permute(materials, 1, order);
+}
+
+size_t countMaterialBatches(size_t count, const int* materials, const std::vector<int>& textureIds)
+{
+	size_t batches = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i == 0 || textureIds[materials[i]] != textureIds[materials[i - 1]])
+			batches++;
+	}
+	return batches;
+}
+
+size_t removeTriangles(size_t count, float* positions, float* normals, float* uvs, int* materials, const std::vector<bool>& removedMaterials)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (removedMaterials[materials[i]])
+			continue;
+		if (kept != i)
+		{
+			memcpy(positions + kept * TRIANGLE_POSITION_FLOATS, positions + i * TRIANGLE_POSITION_FLOATS, TRIANGLE_POSITION_FLOATS * sizeof(float));
+			memcpy(normals + kept * TRIANGLE_NORMAL_FLOATS, normals + i * TRIANGLE_NORMAL_FLOATS, TRIANGLE_NORMAL_FLOATS * sizeof(float));
+			memcpy(uvs + kept * TRIANGLE_UV_FLOATS, uvs + i * TRIANGLE_UV_FLOATS, TRIANGLE_UV_FLOATS * sizeof(float));
+			materials[kept] = materials[i];
+		}
+		kept++;
+	}
+	return kept;
+}
+
+void packObjects(const std::vector<PackItem>& items, size_t capacity, std::vector<size_t>& order, std::vector<bool>& startsDif)
+{
+	order.clear();
+	startsDif.clear();
+
+	float lo[3] = { 0, 0, 0 };
+	float hi[3] = { 0, 0, 0 };
+	bool first = true;
+	for (const PackItem& item : items)
+	{
+		if (item.triangles == 0)
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			lo[k] = (first ? item.centre[k] : std::min(lo[k], item.centre[k]));
+			hi[k] = (first ? item.centre[k] : std::max(hi[k], item.centre[k]));
+		}
+		first = false;
+	}
+
+	// Same 1024^3 grid as the material sort, the index breaks ties
+	std::vector<std::pair<uint64_t, size_t>> curve;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (items[i].triangles == 0)
+			continue;
+		uint32_t cell[3];
+		for (int k = 0; k < 3; k++)
+		{
+			float extent = hi[k] - lo[k];
+			cell[k] = (extent > 0 ? (uint32_t)((items[i].centre[k] - lo[k]) / extent * 1023.0f) : 0);
+		}
+		uint32_t morton = spreadBits(cell[0]) | (spreadBits(cell[1]) << 1) | (spreadBits(cell[2]) << 2);
+		curve.push_back(std::make_pair(((uint64_t)morton << 32) | (uint32_t)i, i));
+	}
+	std::sort(curve.begin(), curve.end());
+
+	std::vector<bool> packed(curve.size(), false);
+	for (size_t i = 0; i < curve.size(); i++)
+	{
+		if (packed[i])
+			continue;
+		packed[i] = true;
+		order.push_back(curve[i].second);
+		startsDif.push_back(true);
+
+		size_t fill = items[curve[i].second].triangles;
+		for (size_t j = i + 1; j < curve.size() && j <= i + PACK_LOOKAHEAD && fill < capacity; j++)
+		{
+			size_t triangles = items[curve[j].second].triangles;
+			if (packed[j] || fill + triangles > capacity)
+				continue;
+			packed[j] = true;
+			order.push_back(curve[j].second);
+			startsDif.push_back(false);
+			fill += triangles;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <DIFBuilder/DIFBuilder.hpp>
+
+// Floats per triangle in each array of a structure-of-arrays triangle batch: three corners with
+// a position, a normal and a uv each
+#define TRIANGLE_POSITION_FLOATS 9
+#define TRIANGLE_NORMAL_FLOATS 9
+#define TRIANGLE_UV_FLOATS 6
+
+// Bytes of one triangle in a batch, including its material index
+#define TRIANGLE_BATCH_BYTES ((TRIANGLE_POSITION_FLOATS + TRIANGLE_NORMAL_FLOATS + TRIANGLE_UV_FLOATS) * sizeof(float) + sizeof(int))
+
+// Writes one triangle into the batch arrays at the given triangle index
+void storeTriangle(const DIF::DIFBuilder::Triangle& triangle, size_t index, float* positions, float* normals, float* uvs);
+
+// Bulk counterpart of DIFBuilder::addTriangle. Feeds count triangles of a batch to the builder,
+// materials index into materialNames so no name is copied per triangle.
+void addTriangles(DIF::DIFBuilder& builder, size_t count, const float* positions, const float* normals, const float* uvs, const int* materials, const std::vector<std::string>& materialNames);
+
+// Reorders the triangles of a batch so each texture's triangles are contiguous, and triangles
+// of one texture follow each other through space along a Morton curve. textureIds maps every
+// material to its texture, materials sharing a texture name share an id.
+void sortTrianglesByMaterial(size_t count, float* positions, float* normals, float* uvs, int* materials, const std::vector<int>& textureIds);
+
+// Number of runs of consecutive triangles with the same texture, each a texture switch for the engine
+size_t countMaterialBatches(size_t count, const int* materials, const std::vector<int>& textureIds);
+
+// How many objects along the curve packObjects looks at to top a dif up
+#define PACK_LOOKAHEAD 64
+
+// An object of the obj, as packObjects sees it
+struct PackItem
+{
+	size_t triangles;
+	float centre[3];
+};
+
+// Packs whole objects into difs of up to capacity triangles. Objects are taken along a Morton
+// curve through their centres and each dif is topped up with the next objects along the curve
+// that still fit, so difs stay full and compact. Objects larger than capacity get difs of their
+// own. Fills order with the objects that have triangles, in dif order, and startsDif with whether
+// each of them begins a new dif.
+void packObjects(const std::vector<PackItem>& items, size_t capacity, std::vector<size_t>& order, std::vector<bool>& startsDif);
+
+// Drops the triangles of the flagged materials from a batch, the rest keep their order at the
+// front. Returns how many triangles are left.
+size_t removeTriangles(size_t count, float* positions, float* normals, float* uvs, int* materials, const std::vector<bool>& removedMaterials);
@@ -0,0 +1,425 @@
+#include "CollisionProxy.hpp"
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+// Sum of weighted squared distances to a set of planes, as the upper triangle of a symmetric 4x4
+// matrix: xx xy xz xw yy yz yw zz zw ww
+struct Quadric
+{
+	double m[10];
+
+	Quadric()
+	{
+		memset(m, 0, sizeof(m));
+	}
+
+	void addPlane(const glm::dvec3& n, double d, double weight)
+	{
+		m[0] += weight * n.x * n.x;
+		m[1] += weight * n.x * n.y;
+		m[2] += weight * n.x * n.z;
+		m[3] += weight * n.x * d;
+		m[4] += weight * n.y * n.y;
+		m[5] += weight * n.y * n.z;
+		m[6] += weight * n.y * d;
+		m[7] += weight * n.z * n.z;
+		m[8] += weight * n.z * d;
+		m[9] += weight * d * d;
+	}
+
+	void add(const Quadric& other)
+	{
+		for (int i = 0; i < 10; i++)
+			m[i] += other.m[i];
+	}
+
+	double error(const glm::dvec3& p) const
+	{
+		return m[0] * p.x * p.x + 2 * m[1] * p.x * p.y + 2 * m[2] * p.x * p.z + 2 * m[3] * p.x
+			+ m[4] * p.y * p.y + 2 * m[5] * p.y * p.z + 2 * m[6] * p.y
+			+ m[7] * p.z * p.z + 2 * m[8] * p.z
+			+ m[9];
+	}
+};
+
+struct ProxyVertex
+{
+	glm::dvec3 position;
+	Quadric quadric;
+	std::vector<uint32_t> faces;
+	// Bumped on every collapse the vertex takes part in, so older queue entries are skipped
+	uint32_t version;
+	bool border;
+	bool removed;
+};
+
+struct ProxyFace
+{
+	uint32_t v[3];
+	bool walkable;
+	bool doubleSided;
+	bool removed;
+};
+
+struct Collapse
+{
+	double cost;
+	uint32_t keep;
+	uint32_t remove;
+	uint32_t keepVersion;
+	uint32_t removeVersion;
+	glm::dvec3 target;
+
+	// Cheapest first, ties broken by vertex so the result does not depend on the queue
+	bool operator<(const Collapse& other) const
+	{
+		if (cost != other.cost)
+			return cost > other.cost;
+		if (keep != other.keep)
+			return keep > other.keep;
+		return remove > other.remove;
+	}
+};
+
+struct PositionKey
+{
+	float p[3];
+	bool operator==(const PositionKey& other) const { return memcmp(p, other.p, sizeof(p)) == 0; }
+};
+
+struct PositionKeyHash
+{
+	size_t operator()(const PositionKey& key) const
+	{
+		uint32_t bits[3];
+		memcpy(bits, key.p, sizeof(bits));
+		return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+	}
+};
+
+class Decimator
+{
+public:
+	Decimator(const float* positions, size_t count);
+	void run(double maxCost);
+	std::vector<float> result() const;
+
+private:
+	glm::dvec3 faceNormal(const ProxyFace& face, uint32_t moved, const glm::dvec3& position) const;
+	bool hasFace(uint32_t vertex, uint32_t other) const;
+	void neighbours(uint32_t vertex, std::vector<uint32_t>& out) const;
+	bool canCollapse(const Collapse& collapse) const;
+	void pushEdge(uint32_t a, uint32_t b);
+	void collapse(const Collapse& collapse);
+
+	std::vector<ProxyVertex> mVertices;
+	std::vector<ProxyFace> mFaces;
+	std::priority_queue<Collapse> mQueue;
+};
+
+Decimator::Decimator(const float* positions, size_t count)
+{
+	// The triangles come with their own copies of every corner, shared corners are welded first
+	std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+	std::map<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>, uint32_t> seen;
+	for (size_t i = 0; i < count; i++)
+	{
+		ProxyFace face;
+		for (int j = 0; j < 3; j++)
+		{
+			PositionKey key;
+			memcpy(key.p, positions + i * 9 + j * 3, sizeof(key.p));
+			auto it = welded.find(key);
+			if (it == welded.end())
+			{
+				ProxyVertex vertex;
+				vertex.position = glm::dvec3(key.p[0], key.p[1], key.p[2]);
+				vertex.version = 0;
+				vertex.border = false;
+				vertex.removed = false;
+				it = welded.insert(std::make_pair(key, (uint32_t)mVertices.size())).first;
+				mVertices.push_back(vertex);
+			}
+			face.v[j] = it->second;
+		}
+		if (face.v[0] == face.v[1] || face.v[1] == face.v[2] || face.v[2] == face.v[0])
+			continue;
+
+		// A face seen before with either winding only makes the earlier one double sided
+		uint32_t sorted[3] = { face.v[0], face.v[1], face.v[2] };
+		std::sort(sorted, sorted + 3);
+		auto key = std::make_pair(sorted[0], std::make_pair(sorted[1], sorted[2]));
+		auto existing = seen.find(key);
+		if (existing != seen.end())
+		{
+			ProxyFace& other = mFaces[existing->second];
+			int shift = (int)(std::find(other.v, other.v + 3, face.v[0]) - other.v);
+			if (other.v[(shift + 1) % 3] != face.v[1])
+				other.doubleSided = true;
+			continue;
+		}
+		seen[key] = (uint32_t)mFaces.size();
+
+		face.walkable = false;
+		face.doubleSided = false;
+		face.removed = false;
+		mFaces.push_back(face);
+	}
+
+	std::map<std::pair<uint32_t, uint32_t>, int> edgeFaces;
+	for (uint32_t f = 0; f < mFaces.size(); f++)
+	{
+		ProxyFace& face = mFaces[f];
+		const glm::dvec3& p0 = mVertices[face.v[0]].position;
+		glm::dvec3 n = glm::cross(mVertices[face.v[1]].position - p0, mVertices[face.v[2]].position - p0);
+		double length = glm::length(n);
+		if (length > 0)
+			n /= length;
+		face.walkable = n.z >= COLLISION_WALKABLE_NZ || (face.doubleSided && -n.z >= COLLISION_WALKABLE_NZ);
+
+		for (int j = 0; j < 3; j++)
+		{
+			ProxyVertex& vertex = mVertices[face.v[j]];
+			vertex.quadric.addPlane(n, -glm::dot(n, p0), face.walkable ? COLLISION_WALKABLE_WEIGHT : 1.0);
+			vertex.faces.push_back(f);
+			uint32_t a = face.v[j], b = face.v[(j + 1) % 3];
+			edgeFaces[std::make_pair(std::min(a, b), std::max(a, b))]++;
+		}
+	}
+
+	// Edges of a single face are borders, held by a plane through them standing on the face
+	for (uint32_t f = 0; f < mFaces.size(); f++)
+	{
+		const ProxyFace& face = mFaces[f];
+		const glm::dvec3& p0 = mVertices[face.v[0]].position;
+		glm::dvec3 n = glm::cross(mVertices[face.v[1]].position - p0, mVertices[face.v[2]].position - p0);
+		for (int j = 0; j < 3; j++)
+		{
+			uint32_t a = face.v[j], b = face.v[(j + 1) % 3];
+			if (edgeFaces[std::make_pair(std::min(a, b), std::max(a, b))] != 1)
+				continue;
+			glm::dvec3 side = glm::cross(mVertices[b].position - mVertices[a].position, n);
+			double length = glm::length(side);
+			if (length == 0)
+				continue;
+			side /= length;
+			double d = -glm::dot(side, mVertices[a].position);
+			mVertices[a].quadric.addPlane(side, d, COLLISION_BORDER_WEIGHT);
+			mVertices[b].quadric.addPlane(side, d, COLLISION_BORDER_WEIGHT);
+			mVertices[a].border = true;
+			mVertices[b].border = true;
+		}
+	}
+
+	for (auto& edge : edgeFaces)
+		pushEdge(edge.first.first, edge.first.second);
+}
+
+glm::dvec3 Decimator::faceNormal(const ProxyFace& face, uint32_t moved, const glm::dvec3& position) const
+{
+	glm::dvec3 p[3];
+	for (int j = 0; j < 3; j++)
+		p[j] = (face.v[j] == moved ? position : mVertices[face.v[j]].position);
+	return glm::cross(p[1] - p[0], p[2] - p[0]);
+}
+
+bool Decimator::hasFace(uint32_t vertex, uint32_t other) const
+{
+	for (uint32_t f : mVertices[vertex].faces)
+	{
+		const ProxyFace& face = mFaces[f];
+		if (!face.removed && (face.v[0] == other || face.v[1] == other || face.v[2] == other))
+			return true;
+	}
+	return false;
+}
+
+void Decimator::neighbours(uint32_t vertex, std::vector<uint32_t>& out) const
+{
+	out.clear();
+	for (uint32_t f : mVertices[vertex].faces)
+	{
+		const ProxyFace& face = mFaces[f];
+		if (face.removed)
+			continue;
+		for (int j = 0; j < 3; j++)
+		{
+			if (face.v[j] != vertex)
+				out.push_back(face.v[j]);
+		}
+	}
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool Decimator::canCollapse(const Collapse& collapse) const
+{
+	const ProxyVertex& keep = mVertices[collapse.keep];
+	const ProxyVertex& remove = mVertices[collapse.remove];
+
+	// Faces on the edge disappear, the ones around it must keep their side and stay walkable
+	int edgeFaces = 0;
+	for (int side = 0; side < 2; side++)
+	{
+		uint32_t moved = (side == 0 ? collapse.keep : collapse.remove);
+		uint32_t other = (side == 0 ? collapse.remove : collapse.keep);
+		for (uint32_t f : mVertices[moved].faces)
+		{
+			const ProxyFace& face = mFaces[f];
+			if (face.removed)
+				continue;
+			if (face.v[0] == other || face.v[1] == other || face.v[2] == other)
+			{
+				edgeFaces += side;
+				continue;
+			}
+			glm::dvec3 before = faceNormal(face, moved, mVertices[moved].position);
+			glm::dvec3 after = faceNormal(face, moved, collapse.target);
+			double length = glm::length(after);
+			if (length < 1e-12 || glm::dot(before, after) < 0.5 * glm::length(before) * length)
+				return false;
+			if (face.walkable && std::fabs(after.z / length) < COLLISION_WALKABLE_NZ)
+				return false;
+		}
+	}
+
+	// Two borders joined through the inside would pinch the mesh
+	if (keep.border && remove.border && edgeFaces != 1)
+		return false;
+
+	// More shared neighbours than faces on the edge would fold the mesh onto itself
+	std::vector<uint32_t> a, b, shared;
+	neighbours(collapse.keep, a);
+	neighbours(collapse.remove, b);
+	std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(shared));
+	return (int)shared.size() <= edgeFaces;
+}
+
+void Decimator::pushEdge(uint32_t a, uint32_t b)
+{
+	const ProxyVertex& va = mVertices[a];
+	const ProxyVertex& vb = mVertices[b];
+	Quadric q = va.quadric;
+	q.add(vb.quadric);
+
+	// The point closest to all planes when there is a single one, else the best of the ends and middle
+	glm::dvec3 candidates[4] = { va.position, vb.position, (va.position + vb.position) * 0.5, glm::dvec3(0) };
+	int candidateCount = 3;
+	glm::dmat3 A(q.m[0], q.m[1], q.m[2], q.m[1], q.m[4], q.m[5], q.m[2], q.m[5], q.m[7]);
+	double det = glm::determinant(A);
+	if (std::fabs(det) > 1e-9)
+	{
+		glm::dvec3 optimum = glm::inverse(A) * -glm::dvec3(q.m[3], q.m[6], q.m[8]);
+		// Near singular systems can throw the point far off, it has to stay around the edge
+		if (glm::length(optimum - candidates[2]) <= glm::length(vb.position - va.position))
+			candidates[candidateCount++] = optimum;
+	}
+
+	Collapse best;
+	best.cost = HUGE_VAL;
+	for (int i = 0; i < candidateCount; i++)
+	{
+		double cost = std::max(0.0, q.error(candidates[i]));
+		if (cost < best.cost)
+		{
+			best.cost = cost;
+			best.target = candidates[i];
+		}
+	}
+	best.keep = std::min(a, b);
+	best.remove = std::max(a, b);
+	best.keepVersion = mVertices[best.keep].version;
+	best.removeVersion = mVertices[best.remove].version;
+	mQueue.push(best);
+}
+
+void Decimator::collapse(const Collapse& collapse)
+{
+	ProxyVertex& keep = mVertices[collapse.keep];
+	ProxyVertex& remove = mVertices[collapse.remove];
+
+	keep.position = collapse.target;
+	keep.quadric.add(remove.quadric);
+	keep.border = keep.border || remove.border;
+	keep.version++;
+	remove.version++;
+	remove.removed = true;
+
+	for (uint32_t f : remove.faces)
+	{
+		ProxyFace& face = mFaces[f];
+		if (face.removed)
+			continue;
+		if (face.v[0] == collapse.keep || face.v[1] == collapse.keep || face.v[2] == collapse.keep)
+		{
+			face.removed = true;
+			continue;
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			if (face.v[j] == collapse.remove)
+				face.v[j] = collapse.keep;
+		}
+		keep.faces.push_back(f);
+	}
+	std::vector<uint32_t>().swap(remove.faces);
+	keep.faces.erase(std::remove_if(keep.faces.begin(), keep.faces.end(), [&](uint32_t f) { return mFaces[f].removed; }), keep.faces.end());
+
+	std::vector<uint32_t> around;
+	neighbours(collapse.keep, around);
+	for (uint32_t other : around)
+		pushEdge(collapse.keep, other);
+}
+
+void Decimator::run(double maxCost)
+{
+	while (!mQueue.empty())
+	{
+		Collapse top = mQueue.top();
+		if (top.cost > maxCost)
+			break;
+		mQueue.pop();
+
+		const ProxyVertex& keep = mVertices[top.keep];
+		const ProxyVertex& remove = mVertices[top.remove];
+		if (keep.removed || remove.removed || keep.version != top.keepVersion || remove.version != top.removeVersion)
+			continue;
+		if (!hasFace(top.keep, top.remove) || !canCollapse(top))
+			continue;
+		collapse(top);
+	}
+}
+
+std::vector<float> Decimator::result() const
+{
+	std::vector<float> out;
+	for (const ProxyFace& face : mFaces)
+	{
+		if (face.removed)
+			continue;
+		for (int side = 0; side < (face.doubleSided ? 2 : 1); side++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const glm::dvec3& p = mVertices[face.v[side == 0 ? j : 2 - j]].position;
+				out.push_back((float)p.x);
+				out.push_back((float)p.y);
+				out.push_back((float)p.z);
+			}
+		}
+	}
+	return out;
+}
+
+std::vector<float> decimateCollision(const float* positions, size_t count, float maxError)
+{
+	Decimator decimator(positions, count);
+	decimator.run((double)maxError * maxError);
+	return decimator.result();
+}
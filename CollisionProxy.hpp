@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Faces whose normal points at least this far up can be walked on. Decimation never tilts them
+// steeper than that.
+#define COLLISION_WALKABLE_NZ 0.7f
+
+// The error of moving a walkable face counts this many times over, so floors are simplified last
+#define COLLISION_WALKABLE_WEIGHT 10.0
+
+// Weight of the planes that hold open borders in place, so proxies of neighbouring difs still meet
+#define COLLISION_BORDER_WEIGHT 1000.0
+
+// Simplifies triangles given as three corners of three floats each by collapsing edges, cheapest
+// first, while the quadric error of a collapse stays below maxError squared. Triangles present
+// with both windings stay double sided. Returns the simplified triangles in the same layout.
+std::vector<float> decimateCollision(const float* positions, size_t count, float maxError);
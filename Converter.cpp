@@ -0,0 +1,1450 @@
+#include "Converter.hpp"
+#include <DIFBuilder/DIFBuilder.hpp>
+#include <tiny_obj_loader.h>
+#define GLM_FORCE_INTRINSICS
+#include <glm/glm.hpp>
+#include <dif/objects/dif.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include "Arena.hpp"
+#include "BuilderInput.hpp"
+#include "CollisionProxy.hpp"
+#include "DifWriter.hpp"
+#include "FileWatcher.hpp"
+#include "Instancing.hpp"
+#include "Lightmap.hpp"
+#include "Manifest.hpp"
+#include "ProcessMemory.hpp"
+#include "Trace.hpp"
+#include "WorkerPool.hpp"
+#ifdef OBJ2DIF_LTALLOC
+#include <ltalloc.h>
+#endif
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+struct ParsedModel
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string err;
+	// The obj and every mtl it pulled in, with the stamps they had when parsed
+	std::vector<std::pair<std::string, uint64_t>> files;
+	uint64_t lastUse;
+};
+
+typedef std::vector<float, ArenaAllocator<float>> FloatList;
+typedef std::vector<int, ArenaAllocator<int>> MaterialList;
+
+// Triangles of one dif waiting to be built as a structure of arrays, materials index into the
+// map's material names. All lists live in the chunk's own arena so worker threads never share an
+// allocator for them.
+struct Chunk
+{
+	std::unique_ptr<Arena> arena;
+	FloatList positions;
+	FloatList normals;
+	FloatList uvs;
+	MaterialList materials;
+	// Holds visual-only triangles, its dif is built without collision
+	bool visualOnly;
+	// Index of the prop the chunk holds in its own frame, -1 for triangles of the map
+	int prop;
+	// Set while the lists are parked in the spill file instead of memory
+	bool spilled;
+	uint64_t spillOffset;
+	size_t spillCount;
+	// Bytes of the memory budget the resident lists hold
+	uint64_t reserved;
+
+	explicit Chunk(size_t capacity) :
+		arena(new Arena(capacity * TRIANGLE_BATCH_BYTES + 64)),
+		positions(FloatList::allocator_type(arena.get())),
+		normals(FloatList::allocator_type(arena.get())),
+		uvs(FloatList::allocator_type(arena.get())),
+		materials(MaterialList::allocator_type(arena.get())),
+		visualOnly(false),
+		prop(-1),
+		spilled(false),
+		spillOffset(0),
+		spillCount(0),
+		reserved(0)
+	{
+		reserve(capacity);
+	}
+
+	size_t size() const { return materials.size(); }
+
+	void reserve(size_t count)
+	{
+		positions.reserve(count * TRIANGLE_POSITION_FLOATS);
+		normals.reserve(count * TRIANGLE_NORMAL_FLOATS);
+		uvs.reserve(count * TRIANGLE_UV_FLOATS);
+		materials.reserve(count);
+	}
+
+	void resize(size_t count)
+	{
+		positions.resize(count * TRIANGLE_POSITION_FLOATS);
+		normals.resize(count * TRIANGLE_NORMAL_FLOATS);
+		uvs.resize(count * TRIANGLE_UV_FLOATS);
+		materials.resize(count);
+	}
+
+	void addTriangle(const DIF::DIFBuilder::Triangle& triangle, int material)
+	{
+		size_t index = size();
+		resize(index + 1);
+		storeTriangle(triangle, index, positions.data(), normals.data(), uvs.data());
+		materials[index] = material;
+	}
+
+	uint64_t stagedBytes() const
+	{
+		return (positions.capacity() + normals.capacity() + uvs.capacity()) * sizeof(float) + materials.capacity() * sizeof(int);
+	}
+
+	// Drops everything the chunk staged at once
+	void release()
+	{
+		FloatList(positions.get_allocator()).swap(positions);
+		FloatList(normals.get_allocator()).swap(normals);
+		FloatList(uvs.get_allocator()).swap(uvs);
+		MaterialList(materials.get_allocator()).swap(materials);
+		arena->release();
+	}
+};
+
+// Temp file that chunks wait in while -max-memory has no room for them. Chunks are appended while
+// the obj is split and read back by whichever worker picks them up. Every conversion gets a file
+// of its own, so server jobs on the same obj do not overwrite each other's chunks.
+class SpillFile
+{
+public:
+	explicit SpillFile(const std::string& objpath) : mFile(NULL), mEnd(0)
+	{
+		static std::atomic<uint64_t> counter(0);
+		mPath = objpath + "." + std::to_string((long long)getpid()) + "-" + std::to_string(++counter) + ".spill";
+	}
+	~SpillFile()
+	{
+		if (mFile != NULL)
+		{
+			fclose(mFile);
+			remove(mPath.c_str());
+		}
+	}
+
+	bool write(Chunk& chunk)
+	{
+		if (mFile == NULL && (mFile = fopen(mPath.c_str(), "w+b")) == NULL)
+			return false;
+		// A short write leaves the position past the last whole chunk
+		if (!seekFile(mFile, mEnd))
+			return false;
+		size_t count = chunk.size();
+		if (fwrite(chunk.positions.data(), sizeof(float), chunk.positions.size(), mFile) != chunk.positions.size() ||
+			fwrite(chunk.normals.data(), sizeof(float), chunk.normals.size(), mFile) != chunk.normals.size() ||
+			fwrite(chunk.uvs.data(), sizeof(float), chunk.uvs.size(), mFile) != chunk.uvs.size() ||
+			fwrite(chunk.materials.data(), sizeof(int), count, mFile) != count)
+			return false;
+		chunk.spilled = true;
+		chunk.spillOffset = mEnd;
+		chunk.spillCount = count;
+		mEnd += count * TRIANGLE_BATCH_BYTES;
+		chunk.release();
+		return true;
+	}
+
+	bool read(Chunk& chunk)
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		if (!seekFile(mFile, chunk.spillOffset))
+			return false;
+		chunk.resize(chunk.spillCount);
+		return fread(chunk.positions.data(), sizeof(float), chunk.positions.size(), mFile) == chunk.positions.size() &&
+			fread(chunk.normals.data(), sizeof(float), chunk.normals.size(), mFile) == chunk.normals.size() &&
+			fread(chunk.uvs.data(), sizeof(float), chunk.uvs.size(), mFile) == chunk.uvs.size() &&
+			fread(chunk.materials.data(), sizeof(int), chunk.spillCount, mFile) == chunk.spillCount;
+	}
+
+	const std::string& path() const { return mPath; }
+
+	// Everything written has to be flushed before the first read
+	bool finish()
+	{
+		return mFile == NULL || fflush(mFile) == 0;
+	}
+
+private:
+	// Spill files of big maps go past 2GB
+	static bool seekFile(FILE* file, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+		return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+	}
+
+	std::string mPath;
+	FILE* mFile;
+	uint64_t mEnd;
+	std::mutex mLock;
+};
+
+// Rough working set of a builder and its finished dif per triangle, counted against -max-memory
+#define BUILD_BYTES_PER_TRIANGLE 2048
+
+struct BuiltChunk
+{
+	int index;
+	int prop;
+	int triangleCount;
+	uint64_t hash;
+	bool cached;
+	std::shared_ptr<DIF::DIF> dif;
+	float boundsMin[3];
+	float boundsMax[3];
+	std::vector<std::string> materials;
+};
+
+struct CachedChunk
+{
+	std::shared_ptr<DIF::DIF> dif;
+	uint64_t lastUse;
+};
+
+// Called on a worker thread as soon as a dif is built or found in the chunk cache
+typedef std::function<void(const BuiltChunk& chunk)> InteriorCallback;
+
+static bool cacheEnabled = false;
+static std::atomic<uint64_t> generationCounter(0);
+static std::map<std::string, std::shared_ptr<ParsedModel>> modelCache;
+static std::mutex modelCacheLock;
+static std::map<uint64_t, CachedChunk> chunkCache;
+static std::mutex chunkCacheLock;
+
+// Chunk hash and output of the difs last written to each path, so only changed difs are rewritten
+static std::map<std::string, std::pair<uint64_t, DifOutput>> writtenChunks;
+static std::mutex writtenChunksLock;
+
+// Parsed mtl file, names map to indices into materials
+struct CachedMaterials
+{
+	uint64_t stamp;
+	std::vector<tinyobj::material_t> materials;
+	std::map<std::string, int> names;
+	uint64_t lastUse;
+};
+
+// Keyed by canonical path, so the map and its platforms parse a shared library only once
+static std::map<std::string, CachedMaterials> materialCache;
+static std::mutex materialCacheLock;
+
+// Loads mtl files through the material cache and records which ones an obj loads so they can be
+// watched and checked for changes
+class CachedMaterialReader : public tinyobj::MaterialReader
+{
+public:
+	CachedMaterialReader(const std::string& baseDir, uint64_t generation) : mBaseDir(baseDir), mGeneration(generation) {}
+	virtual bool operator()(const std::string& matId, std::vector<tinyobj::material_t>* materials, std::map<std::string, int>* matMap, std::string* err)
+	{
+		std::string path = mBaseDir + matId;
+		TraceSpan span("Load mtl", path);
+		uint64_t stamp = fileStamp(path);
+		files.push_back(path);
+
+		std::lock_guard<std::mutex> lock(materialCacheLock);
+		CachedMaterials& cached = materialCache[canonicalPath(path)];
+		// LoadMtl always adds at least a default material, so an empty entry was never parsed
+		if (cached.materials.empty() || cached.stamp != stamp)
+		{
+			cached.materials.clear();
+			cached.names.clear();
+			std::ifstream stream(path.c_str());
+			tinyobj::LoadMtl(&cached.names, &cached.materials, &stream);
+			cached.stamp = stamp;
+		}
+		cached.lastUse = mGeneration;
+
+		// Same result as LoadMtl appending to what earlier mtllib lines loaded
+		int offset = materials->size();
+		for (auto& name : cached.names)
+			matMap->insert(std::make_pair(name.first, name.second + offset));
+		materials->insert(materials->end(), cached.materials.begin(), cached.materials.end());
+
+		if (stamp == 0 && err != NULL)
+			*err += "WARN: Material file [ " + path + " ] not found. Created a default material.";
+		return true;
+	}
+
+	std::vector<std::string> files;
+
+private:
+	std::string mBaseDir;
+	uint64_t mGeneration;
+};
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	// FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// Index k of a mesh loaded with compact indices, -1 for attributes the shape has none of
+static tinyobj::index_t indexAt(const tinyobj::mesh_t& mesh, size_t k)
+{
+	tinyobj::index_t idx;
+	idx.vertex_index = mesh.vertex_indices[k];
+	idx.normal_index = (mesh.attributes & tinyobj::MESH_HAS_NORMALS) ? mesh.normal_indices[k] : -1;
+	idx.texcoord_index = (mesh.attributes & tinyobj::MESH_HAS_TEXCOORDS) ? mesh.texcoord_indices[k] : -1;
+	return idx;
+}
+
+// Back of a triangle for double sided faces: the same corners in reverse order, facing away
+static DIF::DIFBuilder::Triangle backFace(const DIF::DIFBuilder::Triangle& triangle)
+{
+	DIF::DIFBuilder::Triangle back;
+	memset(&back, 0, sizeof(back));
+	for (int j = 0; j < 3; j++)
+	{
+		back.points[2 - j].vertex = triangle.points[j].vertex;
+		back.points[2 - j].uv = triangle.points[j].uv;
+		back.points[2 - j].normal = -triangle.points[j].normal;
+	}
+	return back;
+}
+
+void enableConversionCaches()
+{
+	cacheEnabled = true;
+}
+
+void trimConversionCaches(uint64_t keepSince, size_t maxChunks, size_t maxModels, size_t maxMaterials)
+{
+	{
+		std::lock_guard<std::mutex> lock(chunkCacheLock);
+		std::multimap<uint64_t, uint64_t> byAge;
+		for (auto it = chunkCache.begin(); it != chunkCache.end();)
+		{
+			if (it->second.lastUse < keepSince)
+			{
+				it = chunkCache.erase(it);
+				continue;
+			}
+			byAge.insert(std::make_pair(it->second.lastUse, it->first));
+			it++;
+		}
+		for (auto it = byAge.begin(); chunkCache.size() > maxChunks && it != byAge.end(); it++)
+			chunkCache.erase(it->second);
+	}
+	{
+		std::lock_guard<std::mutex> lock(modelCacheLock);
+		std::multimap<uint64_t, std::string> byAge;
+		for (auto it = modelCache.begin(); it != modelCache.end();)
+		{
+			if (it->second->lastUse < keepSince)
+			{
+				it = modelCache.erase(it);
+				continue;
+			}
+			byAge.insert(std::make_pair(it->second->lastUse, it->first));
+			it++;
+		}
+		for (auto it = byAge.begin(); modelCache.size() > maxModels && it != byAge.end(); it++)
+			modelCache.erase(it->second);
+	}
+	{
+		std::lock_guard<std::mutex> lock(materialCacheLock);
+		std::multimap<uint64_t, std::string> byAge;
+		for (auto it = materialCache.begin(); it != materialCache.end();)
+		{
+			if (it->second.lastUse < keepSince)
+			{
+				it = materialCache.erase(it);
+				continue;
+			}
+			byAge.insert(std::make_pair(it->second.lastUse, it->first));
+			it++;
+		}
+		for (auto it = byAge.begin(); materialCache.size() > maxMaterials && it != byAge.end(); it++)
+			materialCache.erase(it->second);
+	}
+}
+
+static std::shared_ptr<ParsedModel> loadModel(const char* objpath, const ConvertOptions& options, uint64_t generation)
+{
+	// The same obj resolves its mtl files differently depending on the base directory
+	std::string key = options.mtlBaseDir + "\n" + objpath + (options.ignoreNormals ? "\nno normals" : "");
+	if (cacheEnabled)
+	{
+		std::lock_guard<std::mutex> lock(modelCacheLock);
+		auto it = modelCache.find(key);
+		if (it != modelCache.end())
+		{
+			bool unchanged = true;
+			for (auto& file : it->second->files)
+				unchanged = unchanged && fileStamp(file.first) == file.second;
+			if (unchanged)
+			{
+				printf("Using cached %s\n", objpath);
+				it->second->lastUse = generation;
+				return it->second;
+			}
+		}
+	}
+
+	printf("Loading obj file\n");
+	TraceSpan span("Parse obj", objpath);
+	//Read everything we can
+	std::shared_ptr<ParsedModel> model = std::make_shared<ParsedModel>();
+	CachedMaterialReader matReader(options.mtlBaseDir, generation);
+	model->files.push_back(std::make_pair(std::string(objpath), fileStamp(objpath)));
+	model->lastUse = generation;
+	std::ifstream objStream(objpath);
+	if (!objStream)
+		model->err = std::string("Cannot open file [") + objpath + "]\n";
+	else
+	{
+		// Maps without normals or texcoords then only pay for the position indices
+		tinyobj::load_options_t loadOptions;
+		loadOptions.compact_indices = true;
+		loadOptions.load_normals = !options.ignoreNormals;
+		loadOptions.load_tags = false;
+		tinyobj::LoadObj(&model->attrib, &model->shapes, &model->materials, &model->err, &objStream, &matReader, loadOptions);
+	}
+	for (const std::string& mtl : matReader.files)
+		model->files.push_back(std::make_pair(mtl, fileStamp(mtl)));
+
+	//Default material
+	model->materials.push_back(tinyobj::material_t());
+
+	if (cacheEnabled)
+	{
+		std::lock_guard<std::mutex> lock(modelCacheLock);
+		modelCache[key] = model;
+	}
+	return model;
+}
+
+// Drops the convex hulls and the poly lists the engine collides against, the surfaces and the bsp
+// stay so the interior still draws
+static void stripCollision(DIF::Interior& interior)
+{
+	interior.convexHull.clear();
+	interior.convexHullEmitStringCharacter.clear();
+	interior.hullIndex.clear();
+	interior.hullPlaneIndex.clear();
+	interior.hullEmitStringIndex.clear();
+	interior.hullSurfaceIndex.clear();
+	interior.polyListPlaneIndex.clear();
+	interior.polyListPointIndex.clear();
+	interior.polyListStringCharacter.clear();
+	interior.coordBinIndex.clear();
+	for (DIF::Interior::CoordBin& bin : interior.coordBin)
+	{
+		bin.binStart = 0;
+		bin.binCount = 0;
+	}
+}
+
+static MaterialProfile materialProfile(const std::string& name, MaterialProfile fallback)
+{
+	if (name.compare(0, 10, "collision_") == 0)
+		return PROFILE_COLLISION;
+	if (name.compare(0, 6, "nocol_") == 0)
+		return PROFILE_VISUAL;
+	return fallback;
+}
+
+static int buildInteriors(const char* objpath, const ConvertJob& job, WorkerPool& pool, ConvertResult& result, const InteriorCallback& onBuilt, std::vector<DIF::Interior>* pathedInteriors = NULL, uint64_t pathedHash = 0)
+{
+	const ConvertOptions& options = job.options;
+	std::shared_ptr<ParsedModel> model = loadModel(objpath, options, result.generation);
+	const tinyobj::attrib_t& attrib = model->attrib;
+	const std::vector<tinyobj::shape_t>& shapes = model->shapes;
+	const std::vector<tinyobj::material_t>& materials = model->materials;
+
+	printf(model->err.c_str());
+	for (auto& file : model->files)
+		result.files.push_back(file.first);
+
+	// Material names are resolved once per material/shape instead of once per face
+	std::vector<std::string> materialNames;
+	std::vector<int> materialSlots;
+	for (const tinyobj::material_t& material : materials)
+	{
+		materialSlots.push_back(materialNames.size());
+		materialNames.push_back(material.diffuse_texname.substr(0, material.diffuse_texname.length() - 4));
+	}
+
+	// Materials named collision_* only collide and nocol_* ones are only drawn, the rest follow the
+	// profile of the job. Collision-only materials use the texture the engine does not draw.
+	std::vector<MaterialProfile> slotProfiles;
+	bool hasVisualOnly = false;
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		slotProfiles.push_back(materialProfile(materials[i].name, options.profile));
+		if (slotProfiles.back() == PROFILE_COLLISION)
+			materialNames[materialSlots[i]] = "NULL";
+	}
+	std::vector<int> shapeSlots(shapes.size(), -1);
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		const std::vector<int>& ids = shapes[i].mesh.material_ids;
+		if (std::find(ids.begin(), ids.end(), -1) == ids.end())
+			continue;
+		shapeSlots[i] = materialNames.size();
+		slotProfiles.push_back(materialProfile(shapes[i].name, options.profile));
+		materialNames.push_back(slotProfiles.back() == PROFILE_COLLISION ? "NULL" : shapes[i].name);
+	}
+
+	// The builder only sees the names, so slots sharing one are the same texture to the engine
+	std::vector<int> textureIds(materialNames.size());
+	{
+		std::map<std::string, int> ids;
+		for (size_t slot = 0; slot < materialNames.size(); slot++)
+			textureIds[slot] = ids.insert(std::make_pair(materialNames[slot], (int)ids.size())).first->second;
+	}
+	for (MaterialProfile profile : slotProfiles)
+		hasVisualOnly = hasVisualOnly || profile == PROFILE_VISUAL;
+
+	std::vector<Chunk> chunks;
+	Chunk* chunk = NULL;
+	size_t collisionTris = 0;
+	size_t visualTris = 0;
+	size_t keptObjects = 0;
+	size_t cutObjects = 0;
+	int tricount = 0;
+	size_t alltris = 0;
+	size_t totaltris = 0;
+
+	TraceSpan splitSpan("Split into chunks", objpath);
+
+	// Ok so we calculate the bounding box to offset all geometry to fix the weird origin thing
+
+	glm::vec3 min(0.0f);
+	glm::vec3 max(0.0f);
+
+	for (const tinyobj::shape_t& shape : shapes)
+	{
+		size_t vertStart = 0;
+		for (size_t i = 0; i < shape.mesh.num_face_vertices.size(); i++)
+		{
+			int vertexIndex[3] = {
+					shape.mesh.vertex_indices[vertStart + 2],
+					shape.mesh.vertex_indices[vertStart + 1],
+					shape.mesh.vertex_indices[vertStart + 0]
+			};
+
+			for (int j = 0; j < 3; j++) {
+				glm::vec3 vertex = glm::vec3(
+					attrib.vertices[((size_t)vertexIndex[j] * 3) + 0],
+					-attrib.vertices[((size_t)vertexIndex[j] * 3) + 2],
+					attrib.vertices[((size_t)vertexIndex[j] * 3) + 1]
+				);
+
+				if (min.x > vertex.x)
+					min.x = vertex.x;
+				if (min.y > vertex.y)
+					min.y = vertex.y;
+				if (min.z > vertex.z)
+					min.z = vertex.z;
+
+				if (max.x < vertex.x)
+					max.x = vertex.x;
+				if (max.y < vertex.y)
+					max.y = vertex.y;
+				if (max.z < vertex.z)
+					max.z = vertex.z;
+			}
+
+			vertStart += 3;
+		}
+		totaltris += shape.mesh.num_face_vertices.size() * (options.doublesidedfaces ? 2 : 1);
+	}
+
+	// A chunk never holds more than splitcount + 2 triangles, so its lists are sized once up front
+	size_t chunkCapacity = options.splitcount + 2;
+	chunks.push_back(Chunk(std::min<size_t>(chunkCapacity, totaltris)));
+	chunk = &chunks.back();
+
+	// Finished chunks stay in memory while the budget has room for them and go to the spill file otherwise
+	MemoryBudget budget(options.maxMemory);
+	SpillFile spill(objpath);
+	int spilled = 0;
+	bool spillFailed = false;
+	auto finishChunk = [&]()
+	{
+		uint64_t bytes = chunk->stagedBytes();
+		if (budget.tryReserve(bytes))
+			chunk->reserved = bytes;
+		else if (spill.write(*chunk))
+			spilled++;
+		else
+		{
+			// The job fails once the split is done, the chunk must not stay over the limit until then
+			spillFailed = true;
+			chunk->release();
+		}
+	};
+
+	glm::vec3 size = max - min;
+	glm::vec3 off = glm::vec3(1, 1, 1);
+
+	// Every triangle of the map casts shadows, not just the ones in the dif being lit
+	std::vector<float> occluders;
+	if (options.bakeLightmaps)
+		occluders.reserve(totaltris * TRIANGLE_POSITION_FLOATS);
+
+	// Triangles of one object in dif coordinates, staged the way the split below stages them
+	auto stageShape = [&](size_t shapeIndex, Chunk& batch)
+	{
+		const tinyobj::shape_t& shape = shapes[shapeIndex];
+		DIF::DIFBuilder::Triangle triangle;
+		for (size_t i = 0; i < shape.mesh.num_face_vertices.size(); i++)
+		{
+			int material = shape.mesh.material_ids[i];
+			int slot = (material == -1 ? shapeSlots[shapeIndex] : materialSlots[material]);
+			memset(&triangle, 0, sizeof(triangle));
+			for (int j = 0; j < 3; j++)
+			{
+				tinyobj::index_t idx = indexAt(shape.mesh, i * 3 + 2 - j);
+				triangle.points[j].vertex = size + off + glm::vec3(
+					attrib.vertices[((size_t)idx.vertex_index * 3) + 0],
+					-attrib.vertices[((size_t)idx.vertex_index * 3) + 2],
+					attrib.vertices[((size_t)idx.vertex_index * 3) + 1]
+				);
+				if (idx.texcoord_index >= 0 && slotProfiles[slot] != PROFILE_COLLISION)
+					triangle.points[j].uv = glm::vec2(
+						attrib.texcoords[((size_t)idx.texcoord_index * 2) + 0],
+						-attrib.texcoords[((size_t)idx.texcoord_index * 2) + 1]
+					);
+				if (idx.normal_index >= 0)
+					triangle.points[j].normal = glm::vec3(
+						attrib.normals[((size_t)idx.normal_index * 3) + 0],
+						-attrib.normals[((size_t)idx.normal_index * 3) + 2],
+						attrib.normals[((size_t)idx.normal_index * 3) + 1]
+					);
+			}
+			batch.addTriangle(triangle, slot);
+		}
+	};
+
+	// Objects repeated through the map are left out of it, built once each as a prop and placed
+	// by the mission. Moving platforms are always built whole.
+	std::vector<bool> instanced(shapes.size(), false);
+	std::vector<std::vector<PropShape>> props;
+	std::vector<size_t> propShapes;
+	size_t instancedTris = 0;
+	if (options.instanceProps && pathedInteriors != NULL)
+	{
+		TraceSpan instanceSpan("Find repeated objects", objpath);
+		std::vector<std::vector<PropShape>> groups;
+		std::vector<std::vector<size_t>> groupShapes;
+		std::multimap<uint64_t, size_t> groupsByHash;
+		for (size_t shapeIndex = 0; shapeIndex < shapes.size(); shapeIndex++)
+		{
+			const tinyobj::shape_t& shape = shapes[shapeIndex];
+			size_t faces = shape.mesh.num_face_vertices.size();
+			if (faces < INSTANCE_MIN_TRIANGLES || faces * (options.doublesidedfaces ? 2 : 1) > (size_t)options.splitcount)
+				continue;
+			bool visual = false;
+			for (int material : shape.mesh.material_ids)
+				visual = visual || slotProfiles[material == -1 ? shapeSlots[shapeIndex] : materialSlots[material]] == PROFILE_VISUAL;
+			if (visual)
+				continue;
+
+			Chunk batch(faces);
+			stageShape(shapeIndex, batch);
+			PropShape prop = makePropShape(batch.size(), batch.positions.data(), batch.uvs.data(), batch.materials.data());
+
+			size_t group = groups.size();
+			auto range = groupsByHash.equal_range(prop.hash);
+			for (auto it = range.first; it != range.second; it++)
+			{
+				if (sameProp(groups[it->second][0], prop))
+				{
+					group = it->second;
+					break;
+				}
+			}
+			if (group == groups.size())
+			{
+				groups.emplace_back();
+				groupShapes.emplace_back();
+				groupsByHash.insert(std::make_pair(prop.hash, group));
+			}
+			groups[group].push_back(std::move(prop));
+			groupShapes[group].push_back(shapeIndex);
+		}
+
+		for (size_t group = 0; group < groups.size(); group++)
+		{
+			if (groups[group].size() < 2)
+				continue;
+			for (size_t shapeIndex : groupShapes[group])
+			{
+				instanced[shapeIndex] = true;
+				instancedTris += shapes[shapeIndex].mesh.num_face_vertices.size() * (options.doublesidedfaces ? 2 : 1);
+			}
+			props.push_back(std::move(groups[group]));
+			propShapes.push_back(groupShapes[group][0]);
+		}
+	}
+
+
+	// Visual-only triangles get difs of their own in a second pass, so their collision can be dropped
+	int passCount = (hasVisualOnly ? 2 : 1);
+	for (int pass = 0; pass < passCount; pass++)
+	{
+		bool visualPass = (pass == 1);
+		if (visualPass)
+		{
+			if (chunk->size() > 0)
+			{
+				tricount = 0;
+				finishChunk();
+				chunks.push_back(Chunk(std::min<size_t>(chunkCapacity, totaltris - alltris)));
+				chunk = &chunks.back();
+			}
+			chunk->visualOnly = true;
+		}
+
+		// Objects are packed whole into the difs of this pass, in the order packObjects puts them in
+		std::vector<size_t> shapeOrder;
+		std::vector<bool> startsChunk;
+		if (options.keepObjects)
+		{
+			std::vector<PackItem> items(shapes.size());
+			for (size_t shapeIndex = 0; shapeIndex < shapes.size(); shapeIndex++)
+			{
+				const tinyobj::shape_t& shape = shapes[shapeIndex];
+				PackItem& item = items[shapeIndex];
+				item.triangles = 0;
+				if (instanced[shapeIndex])
+					continue;
+				for (size_t i = 0; i < shape.mesh.num_face_vertices.size(); i++)
+				{
+					int material = shape.mesh.material_ids[i];
+					MaterialProfile profile = slotProfiles[material == -1 ? shapeSlots[shapeIndex] : materialSlots[material]];
+					if ((profile == PROFILE_VISUAL) == visualPass)
+						item.triangles += (options.doublesidedfaces ? 2 : 1);
+				}
+
+				glm::vec3 centre(0.0f);
+				size_t corners = shape.mesh.num_face_vertices.size() * 3;
+				for (size_t i = 0; i < corners; i++)
+				{
+					const float* vertex = &attrib.vertices[(size_t)indexAt(shape.mesh, i).vertex_index * 3];
+					centre += glm::vec3(vertex[0], vertex[1], vertex[2]);
+				}
+				centre /= (float)std::max<size_t>(corners, 1);
+				item.centre[0] = centre.x;
+				item.centre[1] = centre.y;
+				item.centre[2] = centre.z;
+
+				if (item.triangles > (size_t)options.splitcount)
+					cutObjects++;
+				else if (item.triangles > 0)
+					keptObjects++;
+			}
+			packObjects(items, options.splitcount, shapeOrder, startsChunk);
+		}
+		else
+		{
+			for (size_t shapeIndex = 0; shapeIndex < shapes.size(); shapeIndex++)
+				shapeOrder.push_back(shapeIndex);
+		}
+
+		for (size_t n = 0; n < shapeOrder.size(); n++) {
+			size_t shapeIndex = shapeOrder[n];
+			const tinyobj::shape_t& shape = shapes[shapeIndex];
+			if (instanced[shapeIndex])
+				continue;
+
+			size_t vertStart = 0;
+			bool split = (options.keepObjects ? startsChunk[n] && chunk->size() > 0 : tricount > options.splitcount);
+			if (split) //Max BSP Node limit: 32767, max BSP Leaf limit: 16383, hence max polygons = 16383
+			{
+				tricount = 0;
+				finishChunk();
+				chunks.push_back(Chunk(std::min<size_t>(chunkCapacity, totaltris - alltris)));
+				chunk = &chunks.back();
+				chunk->visualOnly = visualPass;
+			}
+			for (size_t i = 0; i < shape.mesh.num_face_vertices.size(); i++) {
+
+				int material = shape.mesh.material_ids[i];
+				int slot = (material == -1 ? shapeSlots[shapeIndex] : materialSlots[material]);
+				MaterialProfile profile = slotProfiles[slot];
+				if ((profile == PROFILE_VISUAL) != visualPass)
+				{
+					vertStart += 3;
+					continue;
+				}
+
+				if (tricount > options.splitcount) //Max BSP Node limit: 32767, max BSP Leaf limit: 16383, hence max polygons = 16383
+				{
+					tricount = 0;
+					finishChunk();
+					chunks.push_back(Chunk(std::min<size_t>(chunkCapacity, totaltris - alltris)));
+					chunk = &chunks.back();
+					chunk->visualOnly = visualPass;
+				}
+
+				tinyobj::index_t idx[3] = {
+						indexAt(shape.mesh, vertStart + 2),
+						indexAt(shape.mesh, vertStart + 1),
+						indexAt(shape.mesh, vertStart + 0)
+				};
+
+				// Zeroed so missing normals don't leave garbage in the chunk hash
+				DIF::DIFBuilder::Triangle triangle;
+				memset(&triangle, 0, sizeof(triangle));
+
+				for (int j = 0; j < 3; j++) {
+					triangle.points[j].vertex = size + off + glm::vec3(
+						attrib.vertices[((size_t)idx[j].vertex_index * 3) + 0],
+						-attrib.vertices[((size_t)idx[j].vertex_index * 3) + 2],
+						attrib.vertices[((size_t)idx[j].vertex_index * 3) + 1]
+					);
+					if (idx[j].texcoord_index >= 0)
+						triangle.points[j].uv = glm::vec2(
+							attrib.texcoords[((size_t)idx[j].texcoord_index * 2) + 0],
+							-attrib.texcoords[((size_t)idx[j].texcoord_index * 2) + 1]
+						);
+
+
+					if (idx[j].normal_index >= 0)
+						triangle.points[j].normal = glm::vec3(
+							attrib.normals[((size_t)idx[j].normal_index * 3) + 0],
+							-attrib.normals[((size_t)idx[j].normal_index * 3) + 2],
+							attrib.normals[((size_t)idx[j].normal_index * 3) + 1]
+						);
+
+				}
+
+				if (profile == PROFILE_COLLISION)
+				{
+					// Nothing draws these, so they get no texture coordinates to build tex gens from
+					for (int j = 0; j < 3; j++)
+						triangle.points[j].uv = glm::vec2(0.0f);
+					collisionTris += (options.doublesidedfaces ? 2 : 1);
+				}
+				else if (profile == PROFILE_VISUAL)
+				{
+					visualTris += (options.doublesidedfaces ? 2 : 1);
+				}
+
+				tricount++;
+				alltris++;
+				chunk->addTriangle(triangle, slot);
+				// Invisible collision shells cast no shadows
+				if (options.bakeLightmaps && profile != PROFILE_COLLISION)
+				{
+					for (int j = 0; j < 3; j++)
+						occluders.insert(occluders.end(), { triangle.points[j].vertex.x, triangle.points[j].vertex.y, triangle.points[j].vertex.z });
+				}
+				if (options.doublesidedfaces)
+				{
+					tricount++;
+					alltris++;
+					chunk->addTriangle(backFace(triangle), slot);
+				}
+				//builder.addTriangle(invertedTriangle, (material == -1 ? shape.name : materials[material].name));
+
+				vertStart += 3;
+			}
+
+		}
+	}
+
+	finishChunk();
+
+	// Every prop is staged in its frame as a chunk of its own, and placed once per copy
+	for (size_t p = 0; p < props.size(); p++)
+	{
+		const std::vector<PropShape>& copies = props[p];
+		const PropShape& shape = copies[0];
+		size_t faces = shape.materials.size();
+		chunks.push_back(Chunk(faces * (options.doublesidedfaces ? 2 : 1)));
+		chunk = &chunks.back();
+		chunk->prop = p;
+
+		Chunk batch(faces);
+		stageShape(propShapes[p], batch);
+
+		// The prop keeps the orientation of its first copy, and is moved to positive coordinates
+		// like the map. The placements make up for both.
+		const glm::mat3& facing = shape.frame.rotation;
+		glm::vec3 localMin(0.0f);
+		for (size_t i = 0; i < faces * 3; i++)
+		{
+			glm::vec3 corner = facing * glm::vec3(shape.corners[i * 5 + 0], shape.corners[i * 5 + 1], shape.corners[i * 5 + 2]);
+			localMin = (i == 0 ? corner : glm::min(localMin, corner));
+		}
+		glm::vec3 shift = off - localMin;
+		DIF::DIFBuilder::Triangle triangle;
+		for (size_t i = 0; i < faces; i++)
+		{
+			memset(&triangle, 0, sizeof(triangle));
+			for (int j = 0; j < 3; j++)
+			{
+				const float* corner = &shape.corners[(i * 3 + j) * 5];
+				const float* normal = &batch.normals[i * TRIANGLE_NORMAL_FLOATS + j * 3];
+				triangle.points[j].vertex = facing * glm::vec3(corner[0], corner[1], corner[2]) + shift;
+				triangle.points[j].uv = glm::vec2(corner[3], corner[4]);
+				triangle.points[j].normal = glm::vec3(normal[0], normal[1], normal[2]);
+			}
+			chunk->addTriangle(triangle, shape.materials[i]);
+			if (options.doublesidedfaces)
+				chunk->addTriangle(backFace(triangle), shape.materials[i]);
+
+			if (options.bakeLightmaps && slotProfiles[shape.materials[i]] != PROFILE_COLLISION)
+			{
+				for (const PropShape& copy : copies)
+				{
+					for (int j = 0; j < 3; j++)
+					{
+						glm::vec3 position = copy.frame.rotation * glm::transpose(facing) * (triangle.points[j].vertex - shift) + copy.frame.origin;
+						occluders.insert(occluders.end(), { position.x, position.y, position.z });
+					}
+				}
+			}
+		}
+		alltris += chunk->size();
+
+		for (const PropShape& copy : copies)
+		{
+			PropInstance instance;
+			instance.prop = p;
+			glm::mat3 turn = copy.frame.rotation * glm::transpose(facing);
+			glm::vec4 rotation = axisAngle(turn);
+			glm::vec3 position = copy.frame.origin - turn * shift;
+			for (int k = 0; k < 3; k++)
+				instance.position[k] = position[k];
+			for (int k = 0; k < 4; k++)
+				instance.rotation[k] = rotation[k];
+			result.instances.push_back(instance);
+		}
+		finishChunk();
+	}
+	splitSpan.end();
+
+	std::unique_ptr<LightmapScene> scene;
+	if (options.bakeLightmaps)
+	{
+		TraceSpan sceneSpan("Build lightmap scene", objpath);
+		scene.reset(new LightmapScene(occluders));
+		std::vector<float>().swap(occluders);
+	}
+
+	// Everything the builders need is in the chunks now, so the parsed obj goes before building
+	// starts unless the model cache keeps it for the next conversion. attrib, shapes and materials
+	// must not be touched past this point.
+	uint64_t loadedMemory = residentMemory();
+	bool modelCached = cacheEnabled;
+	model.reset();
+	printf("Building DIFs for %llu triangles\n", (unsigned long long)alltris);
+	if (!props.empty())
+		printf("Placing %d props %d times instead of building %llu triangles\n", (int)props.size(), (int)result.instances.size(), (unsigned long long)instancedTris);
+	if (collisionTris > 0 || visualTris > 0)
+		printf("%llu collision-only and %llu visual-only triangles\n", (unsigned long long)collisionTris, (unsigned long long)visualTris);
+	if (options.keepObjects)
+		printf("Packed %llu objects whole, cut %llu bigger than a dif\n", (unsigned long long)keptObjects, (unsigned long long)cutObjects);
+	if (!modelCached && loadedMemory > 0)
+		printf("Freed parsed obj: resident memory %.1f MB -> %.1f MB\n", loadedMemory / 1048576.0, residentMemory() / 1048576.0);
+	if (spilled > 0)
+		printf("Spilled %d of %d DIFs to disk to stay within the memory limit\n", spilled, (int)chunks.size());
+	if (spillFailed || !spill.finish())
+	{
+		printf("Failed to write %s\n", spill.path().c_str());
+		result.ok = false;
+		result.error = "failed to write " + spill.path();
+		return 0;
+	}
+
+	// Chunks are independent, so each one is a task on the shared pool that hands its result
+	// to onBuilt straight away instead of waiting for the whole map
+	int count = chunks.size();
+	std::vector<int> order(count);
+	for (int index = 0; index < count; index++)
+		order[index] = index;
+	if (job.shuffleSeed != 0)
+		std::shuffle(order.begin(), order.end(), std::mt19937(job.shuffleSeed));
+
+	// With collision proxies every dif of the map is drawn from its own triangles and collided with
+	// through a decimated copy of them in a dif numbered right after the map's, so the numbers of
+	// <name>N.dif have no gaps. Props come last. Moving platforms keep their own collision.
+	int mapCount = count - props.size();
+	std::vector<int> proxyIndex(count, -1);
+	int proxyCount = 0;
+	std::vector<bool> invisibleSlots(materialNames.size(), false);
+	if (options.collisionError > 0 && pathedInteriors != NULL)
+	{
+		for (int index = 0; index < mapCount; index++)
+		{
+			if (!chunks[index].visualOnly)
+				proxyIndex[index] = mapCount + proxyCount++;
+		}
+		for (size_t slot = 0; slot < materialNames.size(); slot++)
+			invisibleSlots[slot] = materialNames[slot] == "NULL";
+	}
+
+	std::atomic<bool> readFailed(false);
+	std::atomic<uint64_t> batchesBefore(0);
+	std::atomic<uint64_t> batchesAfter(0);
+	std::atomic<uint64_t> collisionBefore(0);
+	std::atomic<uint64_t> collisionAfter(0);
+	TaskGroup group(pool, job.priority);
+	for (int index : order)
+	{
+		group.run([&, index]()
+		{
+			Chunk& current = chunks[index];
+
+			// Spilled chunks come back into memory only once the budget has room to build them
+			uint64_t spilledBytes = current.spillCount * TRIANGLE_BATCH_BYTES;
+			uint64_t buildBytes = (current.spilled ? current.spillCount : current.size()) * BUILD_BYTES_PER_TRIANGLE;
+			budget.acquire(buildBytes + spilledBytes);
+			TraceSpan span("Build DIF", std::string(objpath) + " " + std::to_string(index + 1) + "/" + std::to_string(count));
+			if (current.spilled && !spill.read(current))
+			{
+				printf("Failed to read DIF %d/%d back from %s\n", index + 1, count, spill.path().c_str());
+				current.release();
+				budget.release(buildBytes + spilledBytes);
+				readFailed = true;
+				return;
+			}
+
+			if (options.sortMaterials)
+			{
+				size_t before = countMaterialBatches(current.size(), current.materials.data(), textureIds);
+				sortTrianglesByMaterial(current.size(), current.positions.data(), current.normals.data(), current.uvs.data(), current.materials.data(), textureIds);
+				size_t after = countMaterialBatches(current.size(), current.materials.data(), textureIds);
+				printf("DIF %d/%d: %llu material batches, %llu before sorting\n", index + 1, count, (unsigned long long)after, (unsigned long long)before);
+				batchesBefore += before;
+				batchesAfter += after;
+			}
+
+			bool proxied = proxyIndex[index] >= 0;
+			std::vector<float> proxyPositions;
+			if (proxied)
+			{
+				TraceSpan proxySpan("Decimate collision", std::string(objpath) + " " + std::to_string(index + 1) + "/" + std::to_string(count));
+				proxyPositions = decimateCollision(current.positions.data(), current.size(), options.collisionError);
+				size_t before = current.size();
+				size_t after = proxyPositions.size() / TRIANGLE_POSITION_FLOATS;
+				printf("DIF %d/%d: %llu collision triangles, %llu before decimation\n", index + 1, count, (unsigned long long)after, (unsigned long long)before);
+				collisionBefore += before;
+				collisionAfter += after;
+
+				// Collision-only triangles live on in the proxy alone, unless the dif would be left empty
+				size_t kept = removeTriangles(current.size(), current.positions.data(), current.normals.data(), current.uvs.data(), current.materials.data(), invisibleSlots);
+				if (kept > 0)
+					current.resize(kept);
+			}
+
+			// Everything that goes into the builder decides the key of the chunk
+			uint64_t hash = hashBytes(0xcbf29ce484222325ull, current.positions.data(), current.positions.size() * sizeof(float));
+			hash = hashBytes(hash, current.normals.data(), current.normals.size() * sizeof(float));
+			hash = hashBytes(hash, current.uvs.data(), current.uvs.size() * sizeof(float));
+			for (int slot : current.materials)
+				hash = hashBytes(hash, materialNames[slot].c_str(), materialNames[slot].length() + 1);
+			hash = hashBytes(hash, &options.flipNormals, sizeof(options.flipNormals));
+			if (scene && current.prop < 0)
+			{
+				// Lighting depends on the whole map, so any change to it rebakes every dif
+				uint64_t sceneHash = scene->hash();
+				hash = hashBytes(hash, &sceneHash, sizeof(sceneHash));
+				hash = hashBytes(hash, &options.aoSamples, sizeof(options.aoSamples));
+			}
+			if (index == 0 && pathedInteriors != NULL)
+				hash = hashBytes(hash, &pathedHash, sizeof(pathedHash));
+			if (current.visualOnly)
+				hash = hashBytes(hash, &current.visualOnly, sizeof(current.visualOnly));
+			if (proxied)
+				hash = hashBytes(hash, &options.collisionError, sizeof(options.collisionError));
+
+			BuiltChunk built;
+			built.index = (index < mapCount ? index : index + proxyCount);
+			built.prop = current.prop;
+			built.triangleCount = current.size();
+			built.hash = hash;
+			built.cached = false;
+
+			for (int k = 0; k < 3; k++)
+			{
+				built.boundsMin[k] = 0;
+				built.boundsMax[k] = 0;
+			}
+			for (size_t i = 0; i < current.positions.size(); i++)
+			{
+				int k = i % 3;
+				built.boundsMin[k] = (i < 3 ? current.positions[i] : std::min(built.boundsMin[k], current.positions[i]));
+				built.boundsMax[k] = (i < 3 ? current.positions[i] : std::max(built.boundsMax[k], current.positions[i]));
+			}
+			std::vector<bool> usedSlots(materialNames.size(), false);
+			for (int slot : current.materials)
+				usedSlots[slot] = true;
+			for (size_t slot = 0; slot < usedSlots.size(); slot++)
+			{
+				if (usedSlots[slot] && !materialNames[slot].empty() && materialNames[slot] != "NULL")
+					built.materials.push_back(materialNames[slot]);
+			}
+			std::sort(built.materials.begin(), built.materials.end());
+			built.materials.erase(std::unique(built.materials.begin(), built.materials.end()), built.materials.end());
+
+			if (cacheEnabled)
+			{
+				std::lock_guard<std::mutex> lock(chunkCacheLock);
+				auto it = chunkCache.find(hash);
+				if (it != chunkCache.end())
+				{
+					built.dif = it->second.dif;
+					built.cached = true;
+					it->second.lastUse = result.generation;
+				}
+			}
+
+			if (!built.cached)
+			{
+				printf("Building DIF %d/%d\n", index + 1, count);
+
+				DIF::DIFBuilder* builder = new DIF::DIFBuilder();
+				addTriangles(*builder, current.size(), current.positions.data(), current.normals.data(), current.uvs.data(), current.materials.data(), materialNames);
+				// The builder has its own copy, the staged lists would only sit out the build
+				current.release();
+				budget.unreserve(current.reserved);
+				current.reserved = 0;
+				if (index == 0 && pathedInteriors != NULL)
+				{
+					for (int i = 0; i < pathedInteriors->size(); i++)
+					{
+						builder->addPathedInterior(pathedInteriors->at(i), std::vector<DIF::DIFBuilder::Marker>());
+					}
+				}
+				built.dif = std::make_shared<DIF::DIF>();
+				builder->build(*built.dif, options.flipNormals);
+				delete builder;
+
+				if (current.visualOnly || proxied)
+				{
+					for (DIF::Interior& interior : built.dif->interior)
+						stripCollision(interior);
+				}
+
+				// Props are lit by the engine where they are placed
+				if (scene && current.prop < 0)
+				{
+					TraceSpan bakeSpan("Bake lightmaps", std::string(objpath) + " " + std::to_string(index + 1) + "/" + std::to_string(count));
+					for (DIF::Interior& interior : built.dif->interior)
+						bakeLightmaps(interior, *scene, options.aoSamples, pool, job.priority);
+				}
+
+				if (cacheEnabled)
+				{
+					std::lock_guard<std::mutex> lock(chunkCacheLock);
+					CachedChunk& cached = chunkCache[hash];
+					cached.dif = built.dif;
+					cached.lastUse = result.generation;
+				}
+			}
+			else
+			{
+				printf("DIF %d/%d unchanged\n", index + 1, count);
+			}
+
+			current.release();
+			budget.unreserve(current.reserved);
+			onBuilt(built);
+
+			BuiltChunk proxy;
+			proxy.cached = false;
+			if (proxied)
+			{
+				proxy.index = proxyIndex[index];
+				proxy.prop = -1;
+				proxy.triangleCount = proxyPositions.size() / TRIANGLE_POSITION_FLOATS;
+				proxy.hash = hashBytes(0xcbf29ce484222325ull, proxyPositions.data(), proxyPositions.size() * sizeof(float));
+				proxy.hash = hashBytes(proxy.hash, &options.flipNormals, sizeof(options.flipNormals));
+				for (int k = 0; k < 3; k++)
+				{
+					proxy.boundsMin[k] = built.boundsMin[k];
+					proxy.boundsMax[k] = built.boundsMax[k];
+				}
+
+				if (cacheEnabled)
+				{
+					std::lock_guard<std::mutex> lock(chunkCacheLock);
+					auto it = chunkCache.find(proxy.hash);
+					if (it != chunkCache.end())
+					{
+						proxy.dif = it->second.dif;
+						proxy.cached = true;
+						it->second.lastUse = result.generation;
+					}
+				}
+
+				if (!proxy.cached)
+				{
+					TraceSpan proxySpan("Build collision proxy", std::string(objpath) + " " + std::to_string(index + 1) + "/" + std::to_string(count));
+					DIF::DIFBuilder* builder = new DIF::DIFBuilder();
+					DIF::DIFBuilder::Triangle triangle;
+					memset(&triangle, 0, sizeof(triangle));
+					for (size_t i = 0; i < proxyPositions.size(); i += TRIANGLE_POSITION_FLOATS)
+					{
+						for (int j = 0; j < 3; j++)
+							triangle.points[j].vertex = glm::vec3(proxyPositions[i + j * 3 + 0], proxyPositions[i + j * 3 + 1], proxyPositions[i + j * 3 + 2]);
+						builder->addTriangle(triangle, "NULL");
+					}
+					std::vector<float>().swap(proxyPositions);
+					proxy.dif = std::make_shared<DIF::DIF>();
+					builder->build(*proxy.dif, options.flipNormals);
+					delete builder;
+
+					if (cacheEnabled)
+					{
+						std::lock_guard<std::mutex> lock(chunkCacheLock);
+						CachedChunk& cached = chunkCache[proxy.hash];
+						cached.dif = proxy.dif;
+						cached.lastUse = result.generation;
+					}
+				}
+				onBuilt(proxy);
+			}
+#ifdef OBJ2DIF_LTALLOC
+			// Hand the builder's freed planes, nodes and surfaces back once the dif is on disk
+			if (!built.cached || (proxied && !proxy.cached))
+			{
+				built.dif.reset();
+				proxy.dif.reset();
+				ltsqueeze(0);
+			}
+#endif
+			budget.release(buildBytes + spilledBytes);
+		});
+	}
+	group.wait();
+
+	if (options.sortMaterials)
+		printf("Material batches: %llu, %llu before sorting\n", (unsigned long long)batchesAfter, (unsigned long long)batchesBefore);
+	if (proxyCount > 0)
+		printf("Collision triangles: %llu, %llu before decimation\n", (unsigned long long)collisionAfter, (unsigned long long)collisionBefore);
+	if (readFailed)
+	{
+		result.ok = false;
+		result.error = "failed to read difs back from " + spill.path();
+	}
+	return count + proxyCount;
+}
+
+bool parseProfile(const char* name, MaterialProfile& profile)
+{
+	if (strcmp(name, "full") == 0)
+		profile = PROFILE_FULL;
+	else if (strcmp(name, "collision") == 0)
+		profile = PROFILE_COLLISION;
+	else if (strcmp(name, "visual") == 0)
+		profile = PROFILE_VISUAL;
+	else
+		return false;
+	return true;
+}
+
+void parseJobArguments(const std::vector<std::string>& args, ConvertJob& job)
+{
+	bool scanningMPpaths = false;
+
+	for (int i = 0; i < args.size(); i++)
+	{
+		const char* arg = args[i].c_str();
+		const char* value = (i + 1 < args.size() ? args[i + 1].c_str() : "0");
+
+		if (i == 0)
+		{
+			job.objpath = args[0];
+			continue;
+		}
+
+		if (!scanningMPpaths)
+		{
+			if (strcmp(arg, "-flip") == 0)
+				job.options.flipNormals = true;
+
+			if (strcmp(arg, "-double") == 0)
+				job.options.doublesidedfaces = true;
+
+			if (strcmp(arg, "-no-normals") == 0)
+				job.options.ignoreNormals = true;
+
+			if (strcmp(arg, "-sort-materials") == 0)
+				job.options.sortMaterials = true;
+
+			if (strcmp(arg, "-manifest") == 0)
+				job.writeManifest = true;
+
+			if (strcmp(arg, "-lightmaps") == 0)
+				job.options.bakeLightmaps = true;
+
+			if (strcmp(arg, "-ao-samples") == 0)
+				job.options.aoSamples = std::max(0, atoi(value));
+
+			if (strcmp(arg, "-collision-proxy") == 0)
+				job.options.collisionError = std::max(0.0, atof(value));
+
+			if (strcmp(arg, "-instances") == 0)
+				job.options.instanceProps = true;
+
+			if (strcmp(arg, "-keep-objects") == 0)
+				job.options.keepObjects = true;
+
+			if (strcmp(arg, "-profile") == 0 && !parseProfile(value, job.options.profile))
+				printf("Unknown profile %s, expected full, collision or visual\n", value);
+
+			if (strcmp(arg, "-splitcount") == 0)
+				job.options.splitcount = fmin(atoi(value), 16000);
+
+			if (strcmp(arg, "-max-memory") == 0)
+				job.options.maxMemory = strtoull(value, NULL, 10) * 1024 * 1024;
+
+			if (strcmp(arg, "-priority") == 0)
+				job.priority = atoi(value);
+
+			if (strcmp(arg, "-mp") == 0)
+				scanningMPpaths = true;
+		}
+		else
+		{
+			job.mppaths.push_back(args[i]);
+		}
+	}
+}
+
+ConvertResult convert(const ConvertJob& job, WorkerPool& pool)
+{
+	ConvertResult result;
+	result.generation = ++generationCounter;
+
+	std::vector<DIF::Interior> mps;
+	uint64_t mpHash = 0xcbf29ce484222325ull;
+
+	for (int i = 0; i < job.mppaths.size(); i++)
+	{
+		TraceSpan span("Moving platform", job.mppaths[i]);
+		std::map<int, BuiltChunk> mp;
+		std::mutex mpLock;
+		buildInteriors(job.mppaths[i].c_str(), job, pool, result, [&](const BuiltChunk& chunk)
+		{
+			std::lock_guard<std::mutex> lock(mpLock);
+			mp[chunk.index] = chunk;
+		});
+		for (auto& it : mp)
+		{
+			mps.push_back(it.second.dif->interior[0]);
+			mpHash = hashBytes(mpHash, &it.second.hash, sizeof(it.second.hash));
+		}
+	}
+
+	std::string basepath = job.objpath.substr(0, job.objpath.length() - 4);
+	std::atomic<bool> writeFailed(false);
+	std::string writeError;
+	std::map<int, DifOutput> outputs;
+	std::mutex outputsLock;
+	result.difCount = buildInteriors(job.objpath.c_str(), job, pool, result, [&](const BuiltChunk& chunk)
+	{
+		std::string path = (chunk.prop >= 0 ? basepath + "_prop" + std::to_string(chunk.prop) : basepath + std::to_string(chunk.index)) + ".dif";
+		TraceSpan span("Write DIF", path);
+		if (chunk.cached)
+		{
+			std::lock_guard<std::mutex> lock(writtenChunksLock);
+			auto it = writtenChunks.find(path);
+			if (it != writtenChunks.end() && it->second.first == chunk.hash && fileStamp(path) != 0)
+			{
+				std::lock_guard<std::mutex> outputLock(outputsLock);
+				outputs[chunk.index] = it->second.second;
+				return;
+			}
+		}
+
+		std::vector<char> data;
+		if (!serializeDif(*chunk.dif, chunk.triangleCount, data) || (job.writeOutput && !writeFileAtomic(path, data.data(), data.size())))
+		{
+			printf("Failed to write %s\n", path.c_str());
+			std::lock_guard<std::mutex> lock(outputsLock);
+			if (!writeFailed)
+				writeError = "failed to write " + path;
+			writeFailed = true;
+			return;
+		}
+
+		DifOutput output;
+		output.path = path;
+		output.hash = hashBytes(0xcbf29ce484222325ull, data.data(), data.size());
+		output.size = data.size();
+		output.triangleCount = chunk.triangleCount;
+		output.surfaceCount = chunk.dif->interior.empty() ? 0 : chunk.dif->interior[0].surface.size();
+		for (int k = 0; k < 3; k++)
+		{
+			output.boundsMin[k] = chunk.boundsMin[k];
+			output.boundsMax[k] = chunk.boundsMax[k];
+		}
+		output.materials = chunk.materials;
+		{
+			std::lock_guard<std::mutex> lock(outputsLock);
+			outputs[chunk.index] = output;
+		}
+
+		if (!job.writeOutput)
+			return;
+		std::lock_guard<std::mutex> lock(writtenChunksLock);
+		writtenChunks[path] = std::make_pair(chunk.hash, output);
+	}, &mps, mpHash);
+
+	for (auto& it : outputs)
+		result.outputs.push_back(it.second);
+	if (job.writeManifest && job.writeOutput && !writeFailed && !writeManifest(basepath, fileName(job.objpath), result.outputs))
+	{
+		printf("Failed to write %s.manifest.json\n", basepath.c_str());
+		writeError = "failed to write " + basepath + ".manifest.json";
+		writeFailed = true;
+	}
+	if (job.options.instanceProps && job.writeOutput && !writeFailed && !writeInstances(basepath, fileName(job.objpath), result.instances))
+	{
+		printf("Failed to write %s.instances.cs\n", basepath.c_str());
+		writeError = "failed to write " + basepath + ".instances.cs";
+		writeFailed = true;
+	}
+	uint64_t peakMemory = peakResidentMemory();
+	if (peakMemory > 0)
+		printf("Peak memory: %.1f MB\n", peakMemory / 1048576.0);
+	// A spill error of the build came first and explains the difs it left out
+	if (writeFailed && result.ok)
+		result.error = writeError;
+	if (writeFailed)
+		result.ok = false;
+	return result;
+}
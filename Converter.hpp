@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+// Which half of the dif a triangle needs
+enum MaterialProfile
+{
+	PROFILE_FULL,
+	// Collides but is never drawn, such as invisible walls
+	PROFILE_COLLISION,
+	// Drawn but never collided with, such as decorative detail
+	PROFILE_VISUAL
+};
+
+struct ConvertOptions
+{
+	bool flipNormals = false;
+	bool doublesidedfaces = false;
+	bool splitbyaxis = false;
+	// Skip parsing the normals in the obj, for collision maps that do not need them
+	bool ignoreNormals = false;
+	// Order the triangles of each dif by material, so the engine switches textures less often
+	bool sortMaterials = false;
+	// Bake sunlight and ambient occlusion into the lightmaps of every dif
+	bool bakeLightmaps = false;
+	int aoSamples = 16;
+	// Profile of the triangles whose material is not named collision_* or nocol_*
+	MaterialProfile profile = PROFILE_FULL;
+	// Collide with difs of triangles decimated up to this distance instead of the drawn ones, 0 for off
+	float collisionError = 0;
+	// Build objects repeated through the map once each and place their copies from the mission
+	bool instanceProps = false;
+	// Keep every object of the obj in one dif, packing small ones together, unless it is bigger than a dif
+	bool keepObjects = false;
+	int splitcount = 12000;
+	// Bytes the chunks waiting for and being built may use before they are spilled to disk, 0 for no limit
+	uint64_t maxMemory = 0;
+	// Directory mtllib paths are relative to, empty for the working directory
+	std::string mtlBaseDir;
+};
+
+struct ConvertJob
+{
+	std::string objpath;
+	std::vector<std::string> mppaths;
+	ConvertOptions options;
+	int priority = 0;
+	// Off to build and serialise the difs without writing them
+	bool writeOutput = true;
+	// Shuffles the order chunks are handed to the pool in, 0 keeps map order
+	unsigned shuffleSeed = 0;
+	// Also write <name>.manifest.json and <name>.manifest.cs describing every dif
+	bool writeManifest = false;
+};
+
+// A serialised dif of the main map
+struct DifOutput
+{
+	std::string path;
+	uint64_t hash;
+	uint64_t size;
+	int triangleCount;
+	int surfaceCount;
+	// Box around the triangles in dif coordinates
+	float boundsMin[3];
+	float boundsMax[3];
+	// Textures of the triangles, sorted
+	std::vector<std::string> materials;
+};
+
+// One copy of a repeated object, placed by the mission instead of built into the map
+struct PropInstance
+{
+	// The copy is <name>_prop<prop>.dif
+	int prop;
+	float position[3];
+	// Axis and angle in degrees
+	float rotation[4];
+};
+
+struct ConvertResult
+{
+	bool ok = true;
+	// Why the conversion failed, for the server's reply
+	std::string error;
+	int difCount = 0;
+	// Conversion number, for trimming the caches of everything older
+	uint64_t generation = 0;
+	// Every obj and mtl file the conversion read
+	std::vector<std::string> files;
+	// Content hash of every dif the conversion serialised, in chunk order
+	std::vector<DifOutput> outputs;
+	// Placements of the props of the main map
+	std::vector<PropInstance> instances;
+};
+
+// Reads full, collision or visual into profile, false for anything else
+bool parseProfile(const char* name, MaterialProfile& profile);
+
+// Fills job from command line style arguments, the first one being the obj path
+void parseJobArguments(const std::vector<std::string>& args, ConvertJob& job);
+
+ConvertResult convert(const ConvertJob& job, WorkerPool& pool);
+
+// Watch and server modes keep parsed models and built chunks between conversions
+void enableConversionCaches();
+
+// Drops cached chunks, models and mtl libraries last used before the given generation, then the
+// least recently used ones beyond the given limits
+void trimConversionCaches(uint64_t keepSince, size_t maxChunks, size_t maxModels, size_t maxMaterials);
@@ -0,0 +1,160 @@
+#include "DifWriter.hpp"
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <ostream>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+DifBuffer::DifBuffer(size_t reserve) : mSize(0)
+{
+	mData.resize(reserve > 0 ? reserve : 4096);
+	setp(mData.data(), mData.data() + mData.size());
+}
+
+std::vector<char> DifBuffer::release()
+{
+	sync_size();
+	mData.resize(mSize);
+	std::vector<char> out;
+	out.swap(mData);
+	mSize = 0;
+	setp(NULL, NULL);
+	return out;
+}
+
+void DifBuffer::sync_size()
+{
+	size_t cur = pptr() - pbase();
+	if (cur > mSize)
+		mSize = cur;
+}
+
+void DifBuffer::grow(size_t needed)
+{
+	size_t cur = pptr() - pbase();
+	sync_size();
+	size_t cap = mData.size();
+	while (cap < needed)
+		cap *= 2;
+	mData.resize(cap);
+	setp(mData.data(), mData.data() + mData.size());
+	pbump(static_cast<int>(cur));
+}
+
+DifBuffer::int_type DifBuffer::overflow(int_type ch)
+{
+	if (traits_type::eq_int_type(ch, traits_type::eof()))
+		return traits_type::not_eof(ch);
+	grow(mData.size() + 1);
+	*pptr() = traits_type::to_char_type(ch);
+	pbump(1);
+	return ch;
+}
+
+std::streamsize DifBuffer::xsputn(const char* s, std::streamsize n)
+{
+	size_t cur = pptr() - pbase();
+	if (cur + n > mData.size())
+		grow(cur + n);
+	memcpy(pptr(), s, n);
+	// pbump only takes an int, large writes need to be split
+	std::streamsize left = n;
+	while (left > 0)
+	{
+		int step = left > 0x40000000 ? 0x40000000 : static_cast<int>(left);
+		pbump(step);
+		left -= step;
+	}
+	return n;
+}
+
+DifBuffer::pos_type DifBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if (!(which & std::ios_base::out))
+		return pos_type(off_type(-1));
+	sync_size();
+	off_type base = 0;
+	if (dir == std::ios_base::cur)
+		base = pptr() - pbase();
+	else if (dir == std::ios_base::end)
+		base = mSize;
+	return seekpos(pos_type(base + off), which);
+}
+
+DifBuffer::pos_type DifBuffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	if (!(which & std::ios_base::out) || off_type(pos) < 0)
+		return pos_type(off_type(-1));
+	sync_size();
+	size_t target = static_cast<size_t>(off_type(pos));
+	if (target > mData.size())
+		grow(target);
+	if (target > mSize)
+	{
+		memset(mData.data() + mSize, 0, target - mSize);
+		mSize = target;
+	}
+	setp(mData.data(), mData.data() + mData.size());
+	size_t left = target;
+	while (left > 0)
+	{
+		int step = left > 0x40000000 ? 0x40000000 : static_cast<int>(left);
+		pbump(step);
+		left -= step;
+	}
+	return pos;
+}
+
+bool serializeDif(const DIF::DIF& dif, int triangleCount, std::vector<char>& out)
+{
+	DifBuffer buffer(static_cast<size_t>(triangleCount) * DIF_BYTES_PER_TRIANGLE);
+	std::ostream stream(&buffer);
+	if (!dif.write(stream, DIF::Version()))
+		return false;
+	stream.flush();
+	out = buffer.release();
+	return true;
+}
+
+bool writeFileAtomic(const std::string& path, const char* data, size_t size)
+{
+	// Server jobs on the same obj write the same files at once, each needs a temp file of its own
+	static std::atomic<uint64_t> counter(0);
+	std::string tmppath = path + "." + std::to_string((long long)getpid()) + "-" + std::to_string(++counter) + ".tmp";
+	FILE* f = fopen(tmppath.c_str(), "wb");
+	if (f == NULL)
+		return false;
+
+	bool ok = fwrite(data, 1, size, f) == size;
+	ok = fflush(f) == 0 && ok;
+#ifdef _WIN32
+	ok = _commit(_fileno(f)) == 0 && ok;
+#else
+	ok = fsync(fileno(f)) == 0 && ok;
+#endif
+	ok = fclose(f) == 0 && ok;
+	if (!ok)
+	{
+		remove(tmppath.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(tmppath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (rename(tmppath.c_str(), path.c_str()) != 0)
+#endif
+	{
+		remove(tmppath.c_str());
+		return false;
+	}
+	return true;
+}
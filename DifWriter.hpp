@@ -0,0 +1,40 @@
+#pragma once
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <dif/objects/dif.h>
+
+// Rough serialised size of a dif per input triangle, used to pre-size output buffers
+#define DIF_BYTES_PER_TRIANGLE 384
+
+// Growable in-memory stream buffer the difs are serialised into before hitting the disk
+class DifBuffer : public std::streambuf
+{
+public:
+	explicit DifBuffer(size_t reserve = 0);
+
+	const char* data() const { return mData.data(); }
+	size_t size() const { return mSize; }
+	const std::vector<char>& buffer() const { return mData; }
+	std::vector<char> release();
+
+protected:
+	virtual int_type overflow(int_type ch);
+	virtual std::streamsize xsputn(const char* s, std::streamsize n);
+	virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+	virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+private:
+	void grow(size_t needed);
+	void sync_size();
+
+	std::vector<char> mData;
+	size_t mSize;
+};
+
+// Serialises the dif into a buffer sized for the given amount of triangles
+bool serializeDif(const DIF::DIF& dif, int triangleCount, std::vector<char>& out);
+
+// Writes data to a temp file next to path, unique to the write, with a single sequential write
+// and renames it over path, so readers never see a partially written file
+bool writeFileAtomic(const std::string& path, const char* data, size_t size);
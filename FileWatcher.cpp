@@ -0,0 +1,162 @@
+#include "FileWatcher.hpp"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <set>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Time to wait for further writes after a change, exporters usually write the obj and mtl back to back
+#define WATCH_SETTLE_MS 300
+#define WATCH_POLL_MS 500
+
+uint64_t fileStamp(const std::string& path)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return 0;
+#ifdef __linux__
+	uint64_t mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+#else
+	uint64_t mtime = (uint64_t)st.st_mtime;
+#endif
+	return (mtime ^ ((uint64_t)st.st_size << 40)) | 1;
+}
+
+std::string canonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char resolved[_MAX_PATH];
+	if (_fullpath(resolved, path.c_str(), sizeof(resolved)) == NULL)
+		return path;
+	return resolved;
+#else
+	char* resolved = realpath(path.c_str(), NULL);
+	if (resolved == NULL)
+		return path;
+	std::string result = resolved;
+	free(resolved);
+	return result;
+#endif
+}
+
+std::string fileName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return (slash == std::string::npos ? path : path.substr(slash + 1));
+}
+
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	if (slash == std::string::npos)
+		return ".";
+	if (slash == 0)
+		return "/";
+	return path.substr(0, slash);
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	mFd = inotify_init1(IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (mFd >= 0)
+		close(mFd);
+#endif
+}
+
+void FileWatcher::setFiles(const std::vector<std::string>& paths)
+{
+	mFiles.clear();
+	for (const std::string& path : paths)
+		mFiles[path] = fileStamp(path);
+
+#ifdef __linux__
+	if (mFd < 0)
+		return;
+
+	std::set<std::string> dirs;
+	for (const std::string& path : paths)
+		dirs.insert(directoryOf(path));
+
+	for (auto it = mDirs.begin(); it != mDirs.end();)
+	{
+		if (dirs.count(it->second) == 0)
+		{
+			inotify_rm_watch(mFd, it->first);
+			it = mDirs.erase(it);
+		}
+		else
+		{
+			dirs.erase(it->second);
+			it++;
+		}
+	}
+	for (const std::string& dir : dirs)
+	{
+		int wd = inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+		if (wd >= 0)
+			mDirs[wd] = dir;
+		else
+			printf("Could not watch %s, falling back to polling\n", dir.c_str());
+	}
+#endif
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+	std::vector<std::string> changed;
+	for (auto& it : mFiles)
+	{
+		uint64_t stamp = fileStamp(it.first);
+		if (stamp != it.second)
+		{
+			it.second = stamp;
+			changed.push_back(it.first);
+		}
+	}
+	return changed;
+}
+
+std::vector<std::string> FileWatcher::wait()
+{
+	std::set<std::string> changed;
+	for (;;)
+	{
+		bool quiet = true;
+#ifdef __linux__
+		if (mFd >= 0 && mDirs.size() > 0)
+		{
+			// Events only tell us something happened in the directory, the stamps decide what changed
+			struct pollfd pfd = { mFd, POLLIN, 0 };
+			if (::poll(&pfd, 1, changed.empty() ? WATCH_POLL_MS : WATCH_SETTLE_MS) > 0)
+			{
+				char buf[4096];
+				if (read(mFd, buf, sizeof(buf)) > 0)
+					quiet = false;
+			}
+		}
+		else
+#endif
+			std::this_thread::sleep_for(std::chrono::milliseconds(changed.empty() ? WATCH_POLL_MS : WATCH_SETTLE_MS));
+
+		std::vector<std::string> now = poll();
+		if (!now.empty())
+			quiet = false;
+		changed.insert(now.begin(), now.end());
+
+		if (quiet && !changed.empty())
+			return std::vector<std::string>(changed.begin(), changed.end());
+	}
+}
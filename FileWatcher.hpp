@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Cheap change stamp of a file (modification time and size), 0 if the file does not exist
+uint64_t fileStamp(const std::string& path);
+
+// Absolute path with links and relative parts resolved, so one file always gets the same name.
+// Returns the path unchanged if it cannot be resolved.
+std::string canonicalPath(const std::string& path);
+
+// Last component of a path
+std::string fileName(const std::string& path);
+
+// Waits for changes to a set of files. Uses inotify on the containing directories on Linux,
+// so saves that replace the file (as Blender does) are picked up too, and polls elsewhere.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	void setFiles(const std::vector<std::string>& paths);
+
+	// Blocks until at least one watched file changed and no further changes happened for a short
+	// while, then returns the changed files
+	std::vector<std::string> wait();
+
+private:
+	std::vector<std::string> poll();
+
+	std::map<std::string, uint64_t> mFiles;
+#ifdef __linux__
+	int mFd;
+	std::map<int, std::string> mDirs;
+#endif
+};
@@ -0,0 +1,175 @@
+#include "Instancing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+
+// Eigenvectors of a symmetric matrix by Jacobi rotations, as the columns of vectors
+static void symmetricEigen(double a[3][3], double values[3], double vectors[3][3])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			vectors[i][j] = (i == j ? 1.0 : 0.0);
+	}
+
+	for (int sweep = 0; sweep < 50; sweep++)
+	{
+		double off = std::fabs(a[0][1]) + std::fabs(a[0][2]) + std::fabs(a[1][2]);
+		if (off < 1e-15 * (std::fabs(a[0][0]) + std::fabs(a[1][1]) + std::fabs(a[2][2]) + 1e-300))
+			break;
+
+		for (int p = 0; p < 2; p++)
+		{
+			for (int q = p + 1; q < 3; q++)
+			{
+				if (a[p][q] == 0)
+					continue;
+				double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+				double t = (theta >= 0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1));
+				double c = 1 / std::sqrt(t * t + 1);
+				double s = t * c;
+				for (int k = 0; k < 3; k++)
+				{
+					double akp = a[k][p], akq = a[k][q];
+					a[k][p] = c * akp - s * akq;
+					a[k][q] = s * akp + c * akq;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					double apk = a[p][k], aqk = a[q][k];
+					a[p][k] = c * apk - s * aqk;
+					a[q][k] = s * apk + c * aqk;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					double vkp = vectors[k][p], vkq = vectors[k][q];
+					vectors[k][p] = c * vkp - s * vkq;
+					vectors[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+		values[i] = a[i][i];
+}
+
+static PropFrame findPropFrame(size_t count, const float* positions)
+{
+	PropFrame frame;
+	frame.origin = glm::vec3(0.0f);
+	frame.rotation = glm::mat3(1.0f);
+	if (count == 0)
+		return frame;
+
+	size_t corners = count * 3;
+	glm::dvec3 centre(0.0);
+	for (size_t i = 0; i < corners; i++)
+		centre += glm::dvec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]);
+	centre /= (double)corners;
+	frame.origin = glm::vec3(centre);
+
+	double covariance[3][3] = {};
+	for (size_t i = 0; i < corners; i++)
+	{
+		glm::dvec3 d = glm::dvec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]) - centre;
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+				covariance[r][c] += d[r] * d[c];
+		}
+	}
+
+	double values[3], vectors[3][3];
+	symmetricEigen(covariance, values, vectors);
+	int order[3] = { 0, 1, 2 };
+	std::sort(order, order + 3, [&](int a, int b) { return values[a] > values[b]; });
+
+	// Axes that nearly tie would come out differently for every copy
+	double largest = values[order[0]];
+	if (largest <= 0 || values[order[0]] - values[order[1]] < 1e-3 * largest || values[order[1]] - values[order[2]] < 1e-3 * largest)
+		return frame;
+
+	glm::dvec3 axes[3];
+	for (int k = 0; k < 2; k++)
+	{
+		axes[k] = glm::dvec3(vectors[0][order[k]], vectors[1][order[k]], vectors[2][order[k]]);
+
+		// The axis points to the side the corners lean to, symmetric objects have none
+		double skew = 0;
+		double spread = 0;
+		for (size_t i = 0; i < corners; i++)
+		{
+			double d = glm::dot(glm::dvec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]) - centre, axes[k]);
+			skew += d * d * d;
+			spread += std::fabs(d * d * d);
+		}
+		if (std::fabs(skew) < 1e-3 * spread || spread == 0)
+			return frame;
+		if (skew < 0)
+			axes[k] = -axes[k];
+	}
+	axes[2] = glm::cross(axes[0], axes[1]);
+
+	frame.rotation = glm::mat3(glm::vec3(axes[0]), glm::vec3(axes[1]), glm::vec3(axes[2]));
+	return frame;
+}
+
+PropShape makePropShape(size_t count, const float* positions, const float* uvs, const int* materials)
+{
+	PropShape shape;
+	shape.frame = findPropFrame(count, positions);
+	shape.materials.assign(materials, materials + count);
+	shape.corners.reserve(count * 15);
+
+	glm::mat3 toLocal = glm::transpose(shape.frame.rotation);
+	glm::vec3 min(0.0f), max(0.0f);
+	for (size_t i = 0; i < count * 3; i++)
+	{
+		glm::vec3 local = toLocal * (glm::vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]) - shape.frame.origin);
+		shape.corners.insert(shape.corners.end(), { local.x, local.y, local.z, uvs[i * 2 + 0], uvs[i * 2 + 1] });
+		min = (i == 0 ? local : glm::min(min, local));
+		max = (i == 0 ? local : glm::max(max, local));
+	}
+
+	int64_t extent[3];
+	for (int k = 0; k < 3; k++)
+		extent[k] = (int64_t)std::floor((max[k] - min[k]) / INSTANCE_HASH_GRID + 0.5f);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto mix = [&](uint64_t value)
+	{
+		hash ^= value;
+		hash *= 0x100000001b3ull;
+	};
+	mix(count);
+	for (int material : shape.materials)
+		mix((uint64_t)(uint32_t)material);
+	for (int k = 0; k < 3; k++)
+		mix((uint64_t)extent[k]);
+	shape.hash = hash;
+	return shape;
+}
+
+bool sameProp(const PropShape& a, const PropShape& b)
+{
+	if (a.materials != b.materials || a.corners.size() != b.corners.size())
+		return false;
+	for (size_t i = 0; i < a.corners.size(); i++)
+	{
+		if (std::fabs(a.corners[i] - b.corners[i]) > INSTANCE_TOLERANCE)
+			return false;
+	}
+	return true;
+}
+
+glm::vec4 axisAngle(const glm::mat3& rotation)
+{
+	glm::quat q = glm::normalize(glm::quat_cast(rotation));
+	if (q.w < 0)
+		q = -q;
+	float angle = 2.0f * std::acos(std::min(1.0f, q.w));
+	float s = std::sqrt(std::max(0.0f, 1.0f - q.w * q.w));
+	if (s < 1e-6f)
+		return glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	return glm::vec4(q.x / s, q.y / s, q.z / s, glm::degrees(angle));
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Corners closer than this count as the same corner when comparing objects
+#define INSTANCE_TOLERANCE 0.001f
+
+// Objects with fewer triangles stay in the map, an interior of their own costs more than they do
+#define INSTANCE_MIN_TRIANGLES 8
+
+// Objects are only compared when their extents agree on this grid
+#define INSTANCE_HASH_GRID 0.1f
+
+// Frame an object is compared in, dif coordinates = rotation * local + origin. The origin is the
+// centre of the object's corners and the axes are their principal axes. Objects without three
+// distinct, one-sided axes keep the dif axes, so only moved copies of them are found.
+struct PropFrame
+{
+	glm::vec3 origin;
+	glm::mat3 rotation;
+};
+
+// An object moved into its frame
+struct PropShape
+{
+	PropFrame frame;
+	// Position and uv of every corner in the frame, in triangle order
+	std::vector<float> corners;
+	std::vector<int> materials;
+	// Triangle count, materials and extent in the frame, equal for all copies of an object
+	uint64_t hash;
+};
+
+// positions holds three corners of three floats per triangle and uvs three of two
+PropShape makePropShape(size_t count, const float* positions, const float* uvs, const int* materials);
+
+// True if b is a copy of a: the same materials and every corner within INSTANCE_TOLERANCE, with
+// the triangles in the same order
+bool sameProp(const PropShape& a, const PropShape& b);
+
+// Rotation as an axis and an angle in degrees, the way mission files take it
+glm::vec4 axisAngle(const glm::mat3& rotation);
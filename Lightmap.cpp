@@ -0,0 +1,595 @@
+#include "Lightmap.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "WorkerPool.hpp"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHTMAP_SSE
+#include <emmintrin.h>
+#endif
+
+// Sunlight falls along this direction, tilted so walls facing it are lit too
+static const glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.3f, -0.4f, -1.0f));
+static const glm::vec3 sunColor(0.75f, 0.72f, 0.65f);
+static const glm::vec3 ambientColor(0.35f, 0.37f, 0.42f);
+
+// Rays start this far off the surface so they do not hit it again
+#define LIGHTMAP_RAY_OFFSET 0.01f
+
+// Lumels are lit in bands of rows of one surface holding about this many lumels
+#define LIGHTMAP_BAND_LUMELS 1024
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	// FNV-1a
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+LightmapScene::LightmapScene(const std::vector<float>& positions)
+{
+	size_t count = positions.size() / 9;
+	mHash = hashBytes(0xcbf29ce484222325ull, positions.data(), positions.size() * sizeof(float));
+
+	std::vector<uint32_t> triangles(count);
+	std::vector<float> centroids(count * 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		triangles[i] = i;
+		for (int k = 0; k < 3; k++)
+			centroids[i * 3 + k] = (positions[i * 9 + k] + positions[i * 9 + 3 + k] + positions[i * 9 + 6 + k]) / 3.0f;
+	}
+
+	if (count == 0)
+		return;
+	mNodes.reserve(count / 2 + 1);
+	mBlocks.reserve(count / 3 + 1);
+	build(triangles, 0, count, positions, centroids);
+}
+
+uint32_t LightmapScene::build(std::vector<uint32_t>& triangles, size_t begin, size_t end, const std::vector<float>& positions, const std::vector<float>& centroids)
+{
+	uint32_t index = mNodes.size();
+	mNodes.push_back(Node());
+
+	Node node;
+	for (int k = 0; k < 3; k++)
+	{
+		node.min[k] = FLT_MAX;
+		node.max[k] = -FLT_MAX;
+	}
+	float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = begin; i < end; i++)
+	{
+		const float* corners = &positions[triangles[i] * 9];
+		for (int k = 0; k < 3; k++)
+		{
+			node.min[k] = std::min(node.min[k], std::min(corners[k], std::min(corners[3 + k], corners[6 + k])));
+			node.max[k] = std::max(node.max[k], std::max(corners[k], std::max(corners[3 + k], corners[6 + k])));
+			centroidMin[k] = std::min(centroidMin[k], centroids[triangles[i] * 3 + k]);
+			centroidMax[k] = std::max(centroidMax[k], centroids[triangles[i] * 3 + k]);
+		}
+	}
+
+	if (end - begin <= 4)
+	{
+		TriangleBlock block;
+		memset(&block, 0, sizeof(block));
+		for (size_t i = begin; i < end; i++)
+		{
+			const float* corners = &positions[triangles[i] * 9];
+			for (int k = 0; k < 3; k++)
+			{
+				block.v0[k][i - begin] = corners[k];
+				block.e1[k][i - begin] = corners[3 + k] - corners[k];
+				block.e2[k][i - begin] = corners[6 + k] - corners[k];
+			}
+		}
+		node.start = mBlocks.size();
+		node.count = end - begin;
+		mBlocks.push_back(block);
+		mNodes[index] = node;
+		return index;
+	}
+
+	// Median split along the longest axis of the centroids
+	int axis = 0;
+	for (int k = 1; k < 3; k++)
+	{
+		if (centroidMax[k] - centroidMin[k] > centroidMax[axis] - centroidMin[axis])
+			axis = k;
+	}
+	size_t middle = (begin + end) / 2;
+	std::nth_element(triangles.begin() + begin, triangles.begin() + middle, triangles.begin() + end, [&](uint32_t a, uint32_t b)
+	{
+		float ca = centroids[a * 3 + axis];
+		float cb = centroids[b * 3 + axis];
+		return ca < cb || (ca == cb && a < b);
+	});
+
+	build(triangles, begin, middle, positions, centroids);
+	node.start = build(triangles, middle, end, positions, centroids);
+	node.count = 0;
+	mNodes[index] = node;
+	return index;
+}
+
+// Moller-Trumbore against the four triangles of a block at once
+static bool hitsBlock(const float* v0x, const float* v0y, const float* v0z, const float* e1x, const float* e1y, const float* e1z, const float* e2x, const float* e2y, const float* e2z, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+#ifdef LIGHTMAP_SSE
+	__m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	__m128 ax = _mm_loadu_ps(e1x), ay = _mm_loadu_ps(e1y), az = _mm_loadu_ps(e1z);
+	__m128 bx = _mm_loadu_ps(e2x), by = _mm_loadu_ps(e2y), bz = _mm_loadu_ps(e2z);
+
+	// p = d x e2, det = e1 . p
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, bz), _mm_mul_ps(dz, by));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, bx), _mm_mul_ps(dx, bz));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, by), _mm_mul_ps(dy, bx));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, px), _mm_mul_ps(ay, py)), _mm_mul_ps(az, pz));
+	__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+	__m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+	__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(_mm_and_ps(valid, det), _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+
+	// t = o - v0, u = t . p / det
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_loadu_ps(v0x));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_loadu_ps(v0y));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_loadu_ps(v0z));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+	// q = t x e1, v = d . q / det, distance = e2 . q / det
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, az), _mm_mul_ps(tz, ay));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, ax), _mm_mul_ps(tx, az));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, ay), _mm_mul_ps(ty, ax));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+	__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, qx), _mm_mul_ps(by, qy)), _mm_mul_ps(bz, qz)), invDet);
+
+	__m128 zero = _mm_setzero_ps();
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+	valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	valid = _mm_and_ps(valid, _mm_cmpgt_ps(distance, zero));
+	valid = _mm_and_ps(valid, _mm_cmplt_ps(distance, _mm_set1_ps(maxDistance)));
+	return _mm_movemask_ps(valid) != 0;
+#else
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec3 e1(e1x[i], e1y[i], e1z[i]);
+		glm::vec3 e2(e2x[i], e2y[i], e2z[i]);
+		glm::vec3 p = glm::cross(direction, e2);
+		float det = glm::dot(e1, p);
+		if (std::fabs(det) <= 1e-12f)
+			continue;
+		glm::vec3 t = origin - glm::vec3(v0x[i], v0y[i], v0z[i]);
+		float u = glm::dot(t, p) / det;
+		glm::vec3 q = glm::cross(t, e1);
+		float v = glm::dot(direction, q) / det;
+		float distance = glm::dot(e2, q) / det;
+		if (u >= 0 && v >= 0 && u + v <= 1 && distance > 0 && distance < maxDistance)
+			return true;
+	}
+	return false;
+#endif
+}
+
+bool LightmapScene::occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	if (mNodes.empty())
+		return false;
+
+	float o[3] = { origin.x, origin.y, origin.z };
+	float inverse[3];
+	for (int k = 0; k < 3; k++)
+		inverse[k] = (direction[k] != 0 ? 1.0f / direction[k] : FLT_MAX);
+
+	uint32_t stack[64];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0)
+	{
+		const Node& node = mNodes[stack[--depth]];
+
+		// Slab test against the node's box
+		float nearest = 0;
+		float farthest = maxDistance;
+		for (int k = 0; k < 3 && nearest <= farthest; k++)
+		{
+			float t0 = (node.min[k] - o[k]) * inverse[k];
+			float t1 = (node.max[k] - o[k]) * inverse[k];
+			nearest = std::max(nearest, std::min(t0, t1));
+			farthest = std::min(farthest, std::max(t0, t1));
+		}
+		if (nearest > farthest)
+			continue;
+
+		if (node.count > 0)
+		{
+			const TriangleBlock& block = mBlocks[node.start];
+			if (hitsBlock(block.v0[0], block.v0[1], block.v0[2], block.e1[0], block.e1[1], block.e1[2], block.e2[0], block.e2[1], block.e2[2], origin, direction, maxDistance))
+				return true;
+			continue;
+		}
+
+		uint32_t index = &node - mNodes.data();
+		stack[depth++] = node.start;
+		stack[depth++] = index + 1;
+	}
+	return false;
+}
+
+// Where one surface's lumels are and how the plane maps onto them
+struct SurfaceLightmap
+{
+	int sheet;
+	int x;
+	int y;
+	int width;
+	int height;
+	// Plane axes along the lightmap's x and y, and the one the plane is solved for
+	int sAxis;
+	int tAxis;
+	int normalAxis;
+	int logScale;
+	float minS;
+	float minT;
+	// Surfaces the engine does not draw keep a single unlit lumel
+	bool invisible;
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		for (int k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+	}
+	return ~crc;
+}
+
+static void appendU32(std::vector<DIF::U8>& out, uint32_t value)
+{
+	out.push_back(value >> 24);
+	out.push_back(value >> 16);
+	out.push_back(value >> 8);
+	out.push_back(value);
+}
+
+static void appendChunk(std::vector<DIF::U8>& out, const char* type, const std::vector<DIF::U8>& data)
+{
+	appendU32(out, data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	appendU32(out, crc32(0, &out[start], out.size() - start));
+}
+
+// PNG of 8 bit RGB pixels, stored without compression so no zlib is needed
+static std::vector<DIF::U8> encodePng(int width, int height, const std::vector<DIF::U8>& rgb)
+{
+	std::vector<DIF::U8> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	std::vector<DIF::U8> header;
+	appendU32(header, width);
+	appendU32(header, height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });
+	appendChunk(png, "IHDR", header);
+
+	// Every row starts with filter type 0
+	std::vector<DIF::U8> raw;
+	size_t stride = width * 3;
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgb.begin() + y * stride, rgb.begin() + (y + 1) * stride);
+	}
+
+	// zlib stream of stored deflate blocks
+	std::vector<DIF::U8> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset == 0 || offset < raw.size(); offset += 65535)
+	{
+		size_t size = std::min<size_t>(65535, raw.size() - offset);
+		zlib.push_back(offset + size >= raw.size() ? 1 : 0);
+		zlib.push_back(size & 0xff);
+		zlib.push_back(size >> 8);
+		zlib.push_back(~size & 0xff);
+		zlib.push_back((~size >> 8) & 0xff);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+	}
+	uint32_t a = 1, b = 0;
+	for (DIF::U8 byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	appendU32(zlib, (b << 16) | a);
+	appendChunk(png, "IDAT", zlib);
+	appendChunk(png, "IEND", std::vector<DIF::U8>());
+	return png;
+}
+
+// Places the surfaces on sheets in rows of decreasing height
+static int packSurfaces(std::vector<SurfaceLightmap>& maps)
+{
+	std::vector<size_t> order(maps.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return maps[a].height > maps[b].height; });
+
+	int sheets = 0;
+	int x = LIGHTMAP_SHEET_SIZE;
+	int y = 0;
+	int rowHeight = 0;
+	for (size_t i : order)
+	{
+		SurfaceLightmap& map = maps[i];
+		if (x + map.width > LIGHTMAP_SHEET_SIZE)
+		{
+			x = 0;
+			y += rowHeight;
+			rowHeight = 0;
+		}
+		if (sheets == 0 || y + map.height > LIGHTMAP_SHEET_SIZE)
+		{
+			sheets++;
+			x = 0;
+			y = 0;
+			rowHeight = 0;
+		}
+		map.sheet = sheets - 1;
+		map.x = x;
+		map.y = y;
+		x += map.width;
+		rowHeight = std::max(rowHeight, map.height);
+	}
+	return sheets;
+}
+
+// Small deterministic generator, seeded per lumel so the bake does not depend on thread timing
+static uint32_t nextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static glm::vec3 lightLumel(const LightmapScene& scene, const glm::vec3& position, const glm::vec3& normal, int aoSamples, uint32_t seed)
+{
+	glm::vec3 origin = position + normal * LIGHTMAP_RAY_OFFSET;
+	glm::vec3 light(0.0f);
+
+	float facing = glm::dot(normal, -sunDirection);
+	if (facing > 0 && !scene.occluded(origin, -sunDirection, FLT_MAX))
+		light += sunColor * facing;
+
+	// Cosine weighted rays over the hemisphere around the normal
+	glm::vec3 tangent = glm::normalize(glm::cross(normal, std::fabs(normal.z) < 0.9f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0)));
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+	uint32_t state = seed | 1;
+	int open = 0;
+	for (int i = 0; i < aoSamples; i++)
+	{
+		float u1 = (nextRandom(state) >> 8) / 16777216.0f;
+		float u2 = (nextRandom(state) >> 8) / 16777216.0f;
+		float radius = std::sqrt(u1);
+		float angle = 6.2831853f * u2;
+		glm::vec3 direction = tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * std::sqrt(std::max(0.0f, 1.0f - u1));
+		if (!scene.occluded(origin, direction, LIGHTMAP_AO_DISTANCE))
+			open++;
+	}
+	float ao = (aoSamples > 0 ? (float)open / aoSamples : 1.0f);
+	return light + ambientColor * ao;
+}
+
+// Rows rowStart to rowEnd of the lumels of one surface
+struct LumelBand
+{
+	size_t surface;
+	int rowStart;
+	int rowEnd;
+};
+
+// Bands of one bake, lit by the baking thread and by helpers on the pool. The baker is itself a
+// pool task, so it lights bands instead of waiting for helpers that may never get a thread, and
+// returns once every band is lit. Helpers starting after that find no band left and only touch
+// this shared state.
+struct LumelBands
+{
+	std::vector<LumelBand> bands;
+	std::function<void(const LumelBand&)> light;
+	std::atomic<size_t> next{ 0 };
+	size_t lit = 0;
+	std::mutex lock;
+	std::condition_variable allLit;
+
+	void run()
+	{
+		for (size_t band = next++; band < bands.size(); band = next++)
+		{
+			light(bands[band]);
+			std::lock_guard<std::mutex> guard(lock);
+			if (++lit == bands.size())
+				allLit.notify_all();
+		}
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		allLit.wait(guard, [this]() { return lit == bands.size(); });
+	}
+};
+
+// Writes the packed sheets and the texgen of every surface into the interior. The final word packs
+// the log2 scales of both axes and which plane axes they follow, as the engine unpacks it.
+static void storeLightmaps(DIF::Interior& interior, const std::vector<SurfaceLightmap>& maps, const std::vector<std::vector<DIF::U8>>& sheets)
+{
+	interior.lightMap.clear();
+	for (const std::vector<DIF::U8>& pixels : sheets)
+	{
+		DIF::Interior::LightMap lightMap;
+		lightMap.lightMap.data = encodePng(LIGHTMAP_SHEET_SIZE, LIGHTMAP_SHEET_SIZE, pixels);
+		// Flat directions pointing straight out of the surface
+		std::vector<DIF::U8> up(pixels.size());
+		for (size_t i = 0; i < up.size(); i += 3)
+		{
+			up[i + 0] = 128;
+			up[i + 1] = 128;
+			up[i + 2] = 255;
+		}
+		lightMap.lightDirMap.data = encodePng(LIGHTMAP_SHEET_SIZE, LIGHTMAP_SHEET_SIZE, up);
+		lightMap.keepLightMap = 1;
+		interior.lightMap.push_back(lightMap);
+	}
+
+	interior.normalLMapIndex.resize(interior.surface.size());
+	interior.alarmLMapIndex.resize(interior.surface.size());
+	for (size_t i = 0; i < interior.surface.size(); i++)
+	{
+		const SurfaceLightmap& map = maps[i];
+		DIF::Surface& surface = interior.surface[i];
+
+		static const int encodings[3][3] = { { -1, 0, 1 }, { 2, -1, 3 }, { 4, 5, -1 } };
+		int stEncoding = encodings[map.sAxis][map.tAxis];
+		surface.lightMap.finalWord = (DIF::U16)((stEncoding << 13) | (map.logScale << 6) | map.logScale);
+
+		// Plane coordinate minS lands on the left edge of the surface's lumels on its sheet
+		float scale = 1.0f / (float)(1 << map.logScale);
+		surface.lightMap.texGenXDistance = (float)map.x / LIGHTMAP_SHEET_SIZE - map.minS * scale;
+		surface.lightMap.texGenYDistance = (float)map.y / LIGHTMAP_SHEET_SIZE - map.minT * scale;
+		surface.mapOffsetX = map.x;
+		surface.mapOffsetY = map.y;
+		surface.mapSizeX = map.width;
+		surface.mapSizeY = map.height;
+		interior.normalLMapIndex[i] = map.sheet;
+		interior.alarmLMapIndex[i] = map.sheet;
+	}
+}
+
+void bakeLightmaps(DIF::Interior& interior, const LightmapScene& scene, int aoSamples, WorkerPool& pool, int priority)
+{
+	std::vector<SurfaceLightmap> maps(interior.surface.size());
+	std::vector<glm::vec3> normals(interior.surface.size());
+	std::vector<float> distances(interior.surface.size());
+	for (size_t i = 0; i < interior.surface.size(); i++)
+	{
+		const DIF::Surface& surface = interior.surface[i];
+		const DIF::Plane& plane = interior.plane[surface.planeIndex];
+		glm::vec3 normal = interior.normal[plane.normalIndex];
+		normals[i] = (surface.planeFlipped ? -normal : normal);
+		distances[i] = plane.planeDistance;
+
+		// The lightmap lies in the two axes the plane is least steep to
+		SurfaceLightmap& map = maps[i];
+		map.normalAxis = 0;
+		for (int k = 1; k < 3; k++)
+		{
+			if (std::fabs(normal[k]) > std::fabs(normal[map.normalAxis]))
+				map.normalAxis = k;
+		}
+		map.sAxis = (map.normalAxis == 0 ? 1 : 0);
+		map.tAxis = (map.normalAxis == 2 ? 1 : 2);
+
+		float minS = FLT_MAX, maxS = -FLT_MAX, minT = FLT_MAX, maxT = -FLT_MAX;
+		for (DIF::U32 k = 0; k < surface.windingCount; k++)
+		{
+			const glm::vec3& point = interior.point[interior.index[surface.windingStart + k]];
+			minS = std::min(minS, point[map.sAxis]);
+			maxS = std::max(maxS, point[map.sAxis]);
+			minT = std::min(minT, point[map.tAxis]);
+			maxT = std::max(maxT, point[map.tAxis]);
+		}
+		if (surface.windingCount == 0)
+			minS = maxS = minT = maxT = 0;
+
+		// Coarser lumels until the surface fits on a sheet with a lumel of border around it
+		for (map.logScale = LIGHTMAP_LOG_SCALE;; map.logScale++)
+		{
+			float lumel = (float)(1 << map.logScale) / LIGHTMAP_SHEET_SIZE;
+			map.minS = std::floor(minS / lumel) * lumel - lumel;
+			map.minT = std::floor(minT / lumel) * lumel - lumel;
+			map.width = (int)std::ceil((maxS - map.minS) / lumel) + 1;
+			map.height = (int)std::ceil((maxT - map.minT) / lumel) + 1;
+			if ((map.width <= LIGHTMAP_SHEET_SIZE && map.height <= LIGHTMAP_SHEET_SIZE) || map.logScale >= 30)
+				break;
+		}
+		map.width = std::min(map.width, LIGHTMAP_SHEET_SIZE);
+		map.height = std::min(map.height, LIGHTMAP_SHEET_SIZE);
+
+		map.invisible = surface.textureIndex < interior.materialName.size() && interior.materialName[surface.textureIndex] == "NULL";
+		if (map.invisible)
+			map.width = map.height = 1;
+	}
+
+	int sheetCount = packSurfaces(maps);
+
+	// Lumels no surface covers get the ambient light
+	std::vector<std::vector<DIF::U8>> sheets(sheetCount);
+	for (std::vector<DIF::U8>& pixels : sheets)
+	{
+		pixels.resize(LIGHTMAP_SHEET_SIZE * LIGHTMAP_SHEET_SIZE * 3);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (DIF::U8)(ambientColor[i % 3] * 255.0f);
+	}
+
+	std::shared_ptr<LumelBands> bands = std::make_shared<LumelBands>();
+	for (size_t i = 0; i < maps.size(); i++)
+	{
+		const SurfaceLightmap& map = maps[i];
+		if (map.invisible)
+			continue;
+		int rows = std::max(1, LIGHTMAP_BAND_LUMELS / map.width);
+		for (int y = 0; y < map.height; y += rows)
+			bands->bands.push_back(LumelBand{ i, y, std::min(map.height, y + rows) });
+	}
+
+	// Bands write to their own lumels of the sheets, so they need no locking
+	bands->light = [&](const LumelBand& band)
+	{
+		size_t i = band.surface;
+		const SurfaceLightmap& map = maps[i];
+		float lumel = (float)(1 << map.logScale) / LIGHTMAP_SHEET_SIZE;
+		const glm::vec3& planeNormal = interior.normal[interior.plane[interior.surface[i].planeIndex].normalIndex];
+		for (int y = band.rowStart; y < band.rowEnd; y++)
+		{
+			for (int x = 0; x < map.width; x++)
+			{
+				// Centre of the lumel on the plane: n . p + d = 0 solved for the normal axis
+				glm::vec3 position;
+				position[map.sAxis] = map.minS + (x + 0.5f) * lumel;
+				position[map.tAxis] = map.minT + (y + 0.5f) * lumel;
+				float steepness = planeNormal[map.normalAxis];
+				position[map.normalAxis] = (steepness == 0 ? 0 : -(distances[i] + planeNormal[map.sAxis] * position[map.sAxis] + planeNormal[map.tAxis] * position[map.tAxis]) / steepness);
+
+				uint32_t seed = (uint32_t)((i * 2654435761u) ^ (x * 40503u) ^ (y * 2246822519u));
+				glm::vec3 light = lightLumel(scene, position, normals[i], aoSamples, seed);
+
+				DIF::U8* pixel = &sheets[map.sheet][((map.y + y) * LIGHTMAP_SHEET_SIZE + map.x + x) * 3];
+				for (int k = 0; k < 3; k++)
+					pixel[k] = (DIF::U8)std::min(255.0f, std::max(0.0f, light[k] * 255.0f + 0.5f));
+			}
+		}
+	};
+
+	size_t helpers = std::min<size_t>(pool.size() - 1, bands->bands.size() > 0 ? bands->bands.size() - 1 : 0);
+	for (size_t i = 0; i < helpers; i++)
+		pool.submit(priority, [bands]() { bands->run(); });
+	bands->run();
+	bands->wait();
+
+	storeLightmaps(interior, maps, sheets);
+}
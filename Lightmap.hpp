@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <dif/objects/dif.h>
+
+class WorkerPool;
+
+// Edge of a lightmap sheet in lumels
+#define LIGHTMAP_SHEET_SIZE 256
+
+// A sheet spans 2^LIGHTMAP_LOG_SCALE world units, so a lumel is half a unit. Surfaces too big for
+// a sheet get coarser lumels.
+#define LIGHTMAP_LOG_SCALE 7
+
+// Default ambient occlusion rays per lumel
+#define LIGHTMAP_AO_SAMPLES 16
+
+// Ambient occlusion only looks for occluders this close to the surface
+#define LIGHTMAP_AO_DISTANCE 8.0f
+
+// Triangles of the whole map that cast shadows onto the difs, in a bounding volume hierarchy
+// with up to four triangles per leaf so they are tested against a ray in one go
+class LightmapScene
+{
+public:
+	// positions holds three corners of three floats per triangle, in dif coordinates
+	explicit LightmapScene(const std::vector<float>& positions);
+
+	// True if any triangle is hit closer than maxDistance
+	bool occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+	// Changes whenever a triangle does, for the chunk cache keys
+	uint64_t hash() const { return mHash; }
+
+private:
+	struct Node
+	{
+		float min[3];
+		float max[3];
+		// Inner nodes have no triangles, the left child follows the node and start is the right one.
+		// Leaves point start at their block.
+		uint32_t start;
+		uint32_t count;
+	};
+
+	// Four triangles as a corner and two edges, one lane each. Unused lanes are degenerate.
+	struct TriangleBlock
+	{
+		float v0[3][4];
+		float e1[3][4];
+		float e2[3][4];
+	};
+
+	uint32_t build(std::vector<uint32_t>& triangles, size_t begin, size_t end, const std::vector<float>& positions, const std::vector<float>& centroids);
+
+	std::vector<Node> mNodes;
+	std::vector<TriangleBlock> mBlocks;
+	uint64_t mHash;
+};
+
+// Lights every surface of the interior with the sun and ambient occlusion against the scene,
+// packs the lightmaps of all surfaces into sheets and stores them in the interior. The lumels
+// are spread over the pool, so a single dif bakes on every core.
+void bakeLightmaps(DIF::Interior& interior, const LightmapScene& scene, int aoSamples, WorkerPool& pool, int priority);
@@ -0,0 +1,112 @@
+#include "Manifest.hpp"
+#include <cinttypes>
+#include <cstdio>
+#include "Converter.hpp"
+#include "DifWriter.hpp"
+#include "FileWatcher.hpp"
+#include "Trace.hpp"
+
+static std::string formatVector(const char* format, const float* v)
+{
+	char text[128];
+	snprintf(text, sizeof(text), format, v[0], v[1], v[2]);
+	return text;
+}
+
+// Quotes and escapes value as a TorqueScript string
+static std::string torqueString(const std::string& value)
+{
+	std::string out = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (c == '\t')
+			out += "\\t";
+		else if (c == '\n')
+			out += "\\n";
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+static std::string jsonManifest(const std::string& source, const std::vector<DifOutput>& outputs)
+{
+	std::string json = "{\n\t\"source\": " + jsonString(source) + ",\n\t\"difs\": [";
+	for (size_t i = 0; i < outputs.size(); i++)
+	{
+		const DifOutput& output = outputs[i];
+		char counts[128];
+		snprintf(counts, sizeof(counts), "\"triangles\": %d, \"surfaces\": %d, \"size\": %" PRIu64, output.triangleCount, output.surfaceCount, output.size);
+
+		std::string materials;
+		for (size_t j = 0; j < output.materials.size(); j++)
+			materials += (j == 0 ? "" : ", ") + jsonString(output.materials[j]);
+
+		json += (i == 0 ? "\n" : ",\n");
+		json += "\t\t{ \"file\": " + jsonString(fileName(output.path)) + ", " + counts;
+		json += ", \"min\": " + formatVector("[%.9g, %.9g, %.9g]", output.boundsMin);
+		json += ", \"max\": " + formatVector("[%.9g, %.9g, %.9g]", output.boundsMax);
+		json += ", \"materials\": [" + materials + "] }";
+	}
+	return json + "\n\t]\n}\n";
+}
+
+// Entries of $DifManifest[<map>, <index>, <field>], with the materials as tab separated fields so
+// getField and getFieldCount work on them
+static std::string torqueManifest(const std::string& source, const std::vector<DifOutput>& outputs)
+{
+	std::string name = source.substr(0, source.find_last_of('.'));
+	std::string prefix = "$DifManifest[" + torqueString(name) + ", ";
+	std::string script = "// obj2difplus dif manifest for " + source + "\n";
+	script += prefix + "\"count\"] = " + std::to_string(outputs.size()) + ";\n";
+	for (size_t i = 0; i < outputs.size(); i++)
+	{
+		const DifOutput& output = outputs[i];
+		std::string entry = prefix + std::to_string(i) + ", ";
+
+		std::string materials;
+		for (size_t j = 0; j < output.materials.size(); j++)
+			materials += (j == 0 ? "" : "\t") + output.materials[j];
+
+		script += entry + "\"file\"] = " + torqueString(fileName(output.path)) + ";\n";
+		script += entry + "\"min\"] = " + formatVector("\"%.9g %.9g %.9g\"", output.boundsMin) + ";\n";
+		script += entry + "\"max\"] = " + formatVector("\"%.9g %.9g %.9g\"", output.boundsMax) + ";\n";
+		script += entry + "\"triangles\"] = " + std::to_string(output.triangleCount) + ";\n";
+		script += entry + "\"surfaces\"] = " + std::to_string(output.surfaceCount) + ";\n";
+		script += entry + "\"size\"] = " + std::to_string(output.size) + ";\n";
+		script += entry + "\"materials\"] = " + torqueString(materials) + ";\n";
+	}
+	return script;
+}
+
+bool writeManifest(const std::string& basepath, const std::string& source, const std::vector<DifOutput>& outputs)
+{
+	std::string json = jsonManifest(source, outputs);
+	std::string script = torqueManifest(source, outputs);
+	return writeFileAtomic(basepath + ".manifest.json", json.data(), json.size()) &&
+		writeFileAtomic(basepath + ".manifest.cs", script.data(), script.size());
+}
+
+bool writeInstances(const std::string& basepath, const std::string& source, const std::vector<PropInstance>& instances)
+{
+	std::string name = fileName(basepath);
+	std::string script = "// obj2difplus prop placements for " + source + ", exec or paste into the mission\n";
+	script += "new SimGroup() {\n";
+	for (const PropInstance& instance : instances)
+	{
+		char transform[192];
+		snprintf(transform, sizeof(transform), "\t\tposition = \"%.9g %.9g %.9g\";\n\t\trotation = \"%.9g %.9g %.9g %.9g\";\n", instance.position[0], instance.position[1], instance.position[2], instance.rotation[0], instance.rotation[1], instance.rotation[2], instance.rotation[3]);
+		script += "\tnew InteriorInstance() {\n";
+		script += transform;
+		script += "\t\tscale = \"1 1 1\";\n";
+		script += "\t\tinteriorFile = filePath($Con::File) @ " + torqueString("/" + name + "_prop" + std::to_string(instance.prop) + ".dif") + ";\n";
+		script += "\t};\n";
+	}
+	script += "};\n";
+	return writeFileAtomic(basepath + ".instances.cs", script.data(), script.size());
+}
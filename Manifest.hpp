@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct DifOutput;
+struct PropInstance;
+
+// Writes <basepath>.manifest.json and <basepath>.manifest.cs listing the bounds, triangle and
+// surface counts, textures and size of every dif, so the game can stream and cull the difs of a
+// map by distance instead of loading them all at once. source names the obj they came from.
+bool writeManifest(const std::string& basepath, const std::string& source, const std::vector<DifOutput>& outputs);
+
+// Writes <basepath>.instances.cs, a SimGroup with an InteriorInstance for every copy of every prop
+// pointing at the prop difs next to the script
+bool writeInstances(const std::string& basepath, const std::string& source, const std::vector<PropInstance>& instances);
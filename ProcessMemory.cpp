@@ -0,0 +1,50 @@
+#include "ProcessMemory.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+uint64_t residentMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.WorkingSetSize;
+#elif defined(__linux__)
+	// Second field of statm is the resident size in pages
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return 0;
+	unsigned long long size = 0, resident = 0;
+	int fields = fscanf(f, "%llu %llu", &size, &resident);
+	fclose(f);
+	return fields == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
+
+uint64_t peakResidentMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	// Linux reports kilobytes
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
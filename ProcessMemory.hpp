@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+// Memory of the process currently in RAM, 0 where the platform can't tell
+uint64_t residentMemory();
+
+// Highest resident memory of the process so far
+uint64_t peakResidentMemory();
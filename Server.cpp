@@ -0,0 +1,270 @@
+#include "Server.hpp"
+#include <cstdio>
+#include <cstring>
+#include "Converter.hpp"
+#include "WorkerPool.hpp"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+// Cache limits for a long running server, a cached chunk holds a whole built dif
+#define SERVER_MAX_CACHED_CHUNKS 256
+#define SERVER_MAX_CACHED_MODELS 32
+#define SERVER_MAX_CACHED_MATERIALS 64
+#define SERVER_MAX_REQUEST 65536
+
+// Jobs waiting for a runner beyond this are turned away, and a client gets this many seconds to
+// send its request before the next one is accepted
+#define SERVER_MAX_QUEUED_JOBS 256
+#define SERVER_REQUEST_TIMEOUT 5
+
+// Requests are a single line of tab separated fields: the client's working directory followed
+// by the usual command line arguments. The reply is a single "ok <difs>" or "error <message>" line.
+
+struct QueuedJob
+{
+	ConvertJob job;
+	int fd;
+	uint64_t order;
+
+	bool operator<(const QueuedJob& other) const
+	{
+		if (job.priority != other.job.priority)
+			return job.priority < other.job.priority;
+		return order > other.order;
+	}
+};
+
+static bool readLine(int fd, std::string& line)
+{
+	line.clear();
+	char c;
+	while (read(fd, &c, 1) == 1)
+	{
+		if (c == '\n')
+			return true;
+		line += c;
+		if (line.size() > SERVER_MAX_REQUEST)
+			return false;
+	}
+	return false;
+}
+
+static bool writeAll(int fd, const std::string& data)
+{
+	size_t written = 0;
+	while (written < data.size())
+	{
+		ssize_t n = write(fd, data.data() + written, data.size() - written);
+		if (n <= 0)
+			return false;
+		written += n;
+	}
+	return true;
+}
+
+static std::vector<std::string> splitFields(const std::string& line)
+{
+	std::vector<std::string> fields;
+	size_t start = 0;
+	for (;;)
+	{
+		size_t tab = line.find('\t', start);
+		fields.push_back(line.substr(start, tab - start));
+		if (tab == std::string::npos)
+			return fields;
+		start = tab + 1;
+	}
+}
+
+static std::string absolutePath(const std::string& cwd, const std::string& path)
+{
+	if (path.empty() || path[0] == '/')
+		return path;
+	return cwd + "/" + path;
+}
+
+static int openSocket(const char* socketPath, sockaddr_un& addr)
+{
+	if (strlen(socketPath) >= sizeof(addr.sun_path))
+	{
+		printf("Socket path %s is too long\n", socketPath);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socketPath);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		perror("socket");
+	return fd;
+}
+
+int runServer(const char* socketPath, WorkerPool& pool, int concurrentJobs)
+{
+	signal(SIGPIPE, SIG_IGN);
+
+	sockaddr_un addr;
+	int fd = openSocket(socketPath, addr);
+	if (fd < 0)
+		return 1;
+	unlink(socketPath);
+	if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0)
+	{
+		perror(socketPath);
+		close(fd);
+		return 1;
+	}
+
+	enableConversionCaches();
+
+	std::priority_queue<QueuedJob> queue;
+	std::mutex queueLock;
+	std::condition_variable queueWake;
+	uint64_t order = 0;
+
+	// Runners only wait on their own job's chunks, the actual building happens on the pool
+	std::vector<std::thread> runners;
+	for (int i = 0; i < (concurrentJobs > 0 ? concurrentJobs : 1); i++)
+	{
+		runners.push_back(std::thread([&]()
+		{
+			for (;;)
+			{
+				QueuedJob queued;
+				{
+					std::unique_lock<std::mutex> lock(queueLock);
+					queueWake.wait(lock, [&]() { return !queue.empty(); });
+					queued = queue.top();
+					queue.pop();
+				}
+
+				printf("Converting %s (priority %d)\n", queued.job.objpath.c_str(), queued.job.priority);
+				ConvertResult result = convert(queued.job, pool);
+				trimConversionCaches(0, SERVER_MAX_CACHED_CHUNKS, SERVER_MAX_CACHED_MODELS, SERVER_MAX_CACHED_MATERIALS);
+
+				if (result.ok)
+					writeAll(queued.fd, "ok " + std::to_string(result.difCount) + "\n");
+				else
+					writeAll(queued.fd, "error " + (result.error.empty() ? std::string("conversion failed") : result.error) + "\n");
+				close(queued.fd);
+			}
+		}));
+	}
+
+	printf("Listening on %s\n", socketPath);
+	for (;;)
+	{
+		int client = accept(fd, NULL, NULL);
+		if (client < 0)
+			continue;
+
+		// A slow client only holds up accepting the others until its request times out
+		timeval timeout;
+		timeout.tv_sec = SERVER_REQUEST_TIMEOUT;
+		timeout.tv_usec = 0;
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		std::string line;
+		std::vector<std::string> fields;
+		if (readLine(client, line))
+			fields = splitFields(line);
+		if (fields.size() < 2 || fields[0].empty() || fields[1].empty())
+		{
+			writeAll(client, "error malformed request\n");
+			close(client);
+			continue;
+		}
+
+		std::string cwd = fields[0];
+		QueuedJob request;
+		request.fd = client;
+		parseJobArguments(std::vector<std::string>(fields.begin() + 1, fields.end()), request.job);
+		request.job.objpath = absolutePath(cwd, request.job.objpath);
+		for (std::string& mppath : request.job.mppaths)
+			mppath = absolutePath(cwd, mppath);
+		request.job.options.mtlBaseDir = cwd + "/";
+
+		bool queued = false;
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			if (queue.size() < SERVER_MAX_QUEUED_JOBS)
+			{
+				request.order = order++;
+				queue.push(request);
+				queued = true;
+			}
+		}
+		if (!queued)
+		{
+			writeAll(client, "error server busy\n");
+			close(client);
+			continue;
+		}
+		queueWake.notify_one();
+	}
+}
+
+int runClient(const char* socketPath, const std::vector<std::string>& args)
+{
+	sockaddr_un addr;
+	int fd = openSocket(socketPath, addr);
+	if (fd < 0)
+		return 1;
+	if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		perror(socketPath);
+		close(fd);
+		return 1;
+	}
+
+	char cwd[4096];
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+	{
+		perror("getcwd");
+		close(fd);
+		return 1;
+	}
+
+	std::string request = cwd;
+	for (const std::string& arg : args)
+		request += "\t" + arg;
+	request += "\n";
+
+	std::string reply;
+	if (!writeAll(fd, request) || !readLine(fd, reply))
+	{
+		printf("Lost connection to the server\n");
+		close(fd);
+		return 1;
+	}
+	close(fd);
+
+	printf("%s\n", reply.c_str());
+	return reply.compare(0, 3, "ok ") == 0 ? 0 : 1;
+}
+
+#else
+
+int runServer(const char* socketPath, WorkerPool& pool, int concurrentJobs)
+{
+	printf("Server mode needs Unix domain sockets, which are not supported on this platform\n");
+	return 1;
+}
+
+int runClient(const char* socketPath, const std::vector<std::string>& args)
+{
+	printf("Server mode needs Unix domain sockets, which are not supported on this platform\n");
+	return 1;
+}
+
+#endif
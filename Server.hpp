@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+// Accepts conversion jobs on a Unix domain socket until killed, running up to concurrentJobs of
+// them at once. Chunks of all jobs share the pool, ordered by the job's -priority.
+int runServer(const char* socketPath, WorkerPool& pool, int concurrentJobs);
+
+// Hands the command line arguments to a running server and waits for the conversion to finish
+int runClient(const char* socketPath, const std::vector<std::string>& args);
@@ -0,0 +1,130 @@
+#include "Trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include "DifWriter.hpp"
+
+struct TraceEvent
+{
+	const char* name;
+	std::string detail;
+	int thread;
+	uint64_t start;
+	uint64_t duration;
+};
+
+static std::atomic<bool> tracing(false);
+static std::chrono::steady_clock::time_point traceStart;
+static std::vector<TraceEvent> traceEvents;
+static std::mutex traceLock;
+static std::atomic<int> traceThreads(0);
+
+// Small ids in the order threads first record something, the thread starting the trace is 0
+static int traceThread()
+{
+	static thread_local int id = traceThreads++;
+	return id;
+}
+
+static uint64_t traceNow()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+std::string jsonString(const std::string& value)
+{
+	std::string out = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+void startTrace()
+{
+	traceStart = std::chrono::steady_clock::now();
+	traceThread();
+	tracing = true;
+}
+
+bool traceEnabled()
+{
+	return tracing;
+}
+
+TraceSpan::TraceSpan(const char* name, const std::string& detail) : mName(name), mStart(0)
+{
+	if (!tracing)
+		return;
+	mDetail = detail;
+	mStart = traceNow();
+}
+
+TraceSpan::~TraceSpan()
+{
+	end();
+}
+
+void TraceSpan::end()
+{
+	if (!tracing || mName == NULL)
+		return;
+	TraceEvent event;
+	event.name = mName;
+	event.detail.swap(mDetail);
+	event.thread = traceThread();
+	event.start = mStart;
+	event.duration = traceNow() - mStart;
+
+	mName = NULL;
+
+	std::lock_guard<std::mutex> lock(traceLock);
+	traceEvents.push_back(std::move(event));
+}
+
+bool writeTrace(const std::string& path)
+{
+	std::string json = "{\"traceEvents\":[\n";
+	char line[256];
+
+	// Name the threads so the viewer shows the main thread apart from the workers
+	int threads = traceThreads;
+	for (int i = 0; i < threads; i++)
+	{
+		snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}},\n", i, i == 0 ? "main" : "worker", i);
+		json += line;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(traceLock);
+		for (const TraceEvent& event : traceEvents)
+		{
+			snprintf(line, sizeof(line), "{\"name\":%s,\"cat\":\"obj2dif\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu", jsonString(event.name).c_str(), event.thread, (unsigned long long)event.start, (unsigned long long)event.duration);
+			json += line;
+			if (!event.detail.empty())
+				json += ",\"args\":{\"detail\":" + jsonString(event.detail) + "}";
+			json += "},\n";
+		}
+	}
+
+	// No comma after the last event
+	if (json.compare(json.length() - 2, 2, ",\n") == 0)
+		json.erase(json.length() - 2);
+	json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return writeFileAtomic(path, json.data(), json.size());
+}
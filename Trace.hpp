@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// Records the spans of every thread once started, so conversions can be opened in a trace viewer
+// (chrome://tracing, Perfetto) to see idle threads and slow difs
+void startTrace();
+bool traceEnabled();
+
+// Writes everything recorded so far in the Chrome trace event format
+bool writeTrace(const std::string& path);
+
+// Quotes and escapes value as a JSON string
+std::string jsonString(const std::string& value);
+
+// Span from construction to destruction on the calling thread, free when tracing is off
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name, const std::string& detail = std::string());
+	~TraceSpan();
+
+	// Ends the span before the end of its scope
+	void end();
+
+private:
+	const char* mName;
+	std::string mDetail;
+	uint64_t mStart;
+};
@@ -0,0 +1,82 @@
+#include "Verify.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include "Converter.hpp"
+#include "DifWriter.hpp"
+#include "FileWatcher.hpp"
+#include "WorkerPool.hpp"
+
+int verifyDeterminism(const ConvertJob& job, int threads)
+{
+	// At least two threads, so the parallel builds really finish chunks out of order
+	int parallel = std::max(threads, 2);
+	struct Build
+	{
+		int threads;
+		unsigned shuffleSeed;
+	};
+	const Build builds[] = { { 1, 0 }, { parallel, 0 }, { parallel, 1 } };
+	const int buildCount = sizeof(builds) / sizeof(builds[0]);
+
+	std::vector<DifOutput> reference;
+	bool identical = true;
+	for (int i = 0; i < buildCount; i++)
+	{
+		printf("Build %d/%d: %d thread%s%s\n", i + 1, buildCount, builds[i].threads, builds[i].threads == 1 ? "" : "s", builds[i].shuffleSeed != 0 ? ", shuffled" : "");
+
+		ConvertJob run = job;
+		run.writeOutput = (i == 0);
+		run.shuffleSeed = builds[i].shuffleSeed;
+		WorkerPool pool(builds[i].threads);
+		ConvertResult result = convert(run, pool);
+		if (!result.ok)
+			return 1;
+
+		if (i == 0)
+		{
+			reference = result.outputs;
+			continue;
+		}
+
+		if (result.outputs.size() != reference.size())
+		{
+			printf("Build %d produced %d DIFs instead of %d\n", i + 1, (int)result.outputs.size(), (int)reference.size());
+			identical = false;
+			continue;
+		}
+		for (size_t j = 0; j < reference.size(); j++)
+		{
+			if (result.outputs[j].hash != reference[j].hash || result.outputs[j].size != reference[j].size)
+			{
+				printf("%s differs: %016" PRIx64 " on 1 thread, %016" PRIx64 " in build %d\n", fileName(reference[j].path).c_str(), reference[j].hash, result.outputs[j].hash, i + 1);
+				identical = false;
+			}
+		}
+	}
+
+	if (!identical)
+	{
+		printf("DIFs are not deterministic\n");
+		return 1;
+	}
+
+	// One line per dif: FNV-1a 64 hash of the file, its size in bytes and its name
+	std::string manifest = "# obj2difplus dif hashes: fnv1a64 size file\n";
+	for (const DifOutput& output : reference)
+	{
+		char line[64];
+		snprintf(line, sizeof(line), "%016" PRIx64 " %" PRIu64 " ", output.hash, output.size);
+		manifest += line + fileName(output.path) + "\n";
+	}
+
+	std::string path = job.objpath.substr(0, job.objpath.length() - 4) + ".hashes";
+	if (!writeFileAtomic(path, manifest.data(), manifest.size()))
+	{
+		printf("Failed to write %s\n", path.c_str());
+		return 1;
+	}
+	printf("All %d DIFs identical across %d builds, hashes written to %s\n", (int)reference.size(), buildCount, path.c_str());
+	return 0;
+}
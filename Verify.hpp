@@ -0,0 +1,8 @@
+#pragma once
+
+struct ConvertJob;
+
+// Converts the job on one thread, then twice more on several threads with the chunks handed out in
+// map and in shuffled order, and compares the hashes of the serialised difs. Writes the difs of the
+// first build and, when all builds agree, a <name>.hashes manifest next to them.
+int verifyDeterminism(const ConvertJob& job, int threads);
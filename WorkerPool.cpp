@@ -0,0 +1,105 @@
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(int threads) : mOrder(0), mStop(false)
+{
+	for (int i = 0; i < (threads > 0 ? threads : 1); i++)
+		mThreads.push_back(std::thread(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (auto& thread : mThreads)
+		thread.join();
+}
+
+void WorkerPool::submit(int priority, std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		Task t;
+		t.priority = priority;
+		t.order = mOrder++;
+		t.fn = std::move(task);
+		mQueue.push(std::move(t));
+	}
+	mWake.notify_one();
+}
+
+void WorkerPool::run()
+{
+	for (;;)
+	{
+		std::function<void()> fn;
+		{
+			std::unique_lock<std::mutex> lock(mLock);
+			mWake.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+			if (mQueue.empty())
+				return;
+			fn = std::move(const_cast<Task&>(mQueue.top()).fn);
+			mQueue.pop();
+		}
+		fn();
+	}
+}
+
+void TaskGroup::run(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mPending++;
+	}
+	mPool.submit(mPriority, [this, task]()
+	{
+		task();
+		std::lock_guard<std::mutex> lock(mLock);
+		if (--mPending == 0)
+			mDone.notify_all();
+	});
+}
+
+void TaskGroup::wait()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	mDone.wait(lock, [this]() { return mPending == 0; });
+}
+
+bool MemoryBudget::tryReserve(uint64_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (mLimit != 0 && mUsed + bytes > mLimit)
+		return false;
+	mUsed += bytes;
+	return true;
+}
+
+void MemoryBudget::unreserve(uint64_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mUsed -= bytes;
+	}
+	mFreed.notify_all();
+}
+
+void MemoryBudget::acquire(uint64_t bytes)
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	mFreed.wait(lock, [this, bytes]() { return mLimit == 0 || mUsed + bytes <= mLimit || mHolders == 0; });
+	mUsed += bytes;
+	mHolders++;
+}
+
+void MemoryBudget::release(uint64_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mUsed -= bytes;
+		mHolders--;
+	}
+	mFreed.notify_all();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads shared by every conversion in the process
+class WorkerPool
+{
+public:
+	explicit WorkerPool(int threads);
+	~WorkerPool();
+
+	// Tasks with a higher priority run first, equal priorities run in submission order
+	void submit(int priority, std::function<void()> task);
+	int size() const { return mThreads.size(); }
+
+private:
+	struct Task
+	{
+		int priority;
+		uint64_t order;
+		std::function<void()> fn;
+
+		bool operator<(const Task& other) const
+		{
+			if (priority != other.priority)
+				return priority < other.priority;
+			return order > other.order;
+		}
+	};
+
+	void run();
+
+	std::vector<std::thread> mThreads;
+	std::priority_queue<Task> mQueue;
+	std::mutex mLock;
+	std::condition_variable mWake;
+	uint64_t mOrder;
+	bool mStop;
+};
+
+// Batch of tasks on a pool that can be waited on together
+class TaskGroup
+{
+public:
+	TaskGroup(WorkerPool& pool, int priority) : mPool(pool), mPriority(priority), mPending(0) {}
+	~TaskGroup() { wait(); }
+
+	void run(std::function<void()> task);
+	void wait();
+
+private:
+	WorkerPool& mPool;
+	int mPriority;
+	int mPending;
+	std::mutex mLock;
+	std::condition_variable mDone;
+};
+
+// Memory limit shared by the chunks of one conversion, 0 for no limit. Reservations never block
+// and fail when over the limit, acquire waits for room unless nothing else is acquired, so a chunk
+// bigger than the whole budget still gets built on its own.
+class MemoryBudget
+{
+public:
+	explicit MemoryBudget(uint64_t limit) : mLimit(limit), mUsed(0), mHolders(0) {}
+
+	bool tryReserve(uint64_t bytes);
+	void unreserve(uint64_t bytes);
+	void acquire(uint64_t bytes);
+	void release(uint64_t bytes);
+
+private:
+	uint64_t mLimit;
+	uint64_t mUsed;
+	int mHolders;
+	std::mutex mLock;
+	std::condition_variable mFreed;
+};
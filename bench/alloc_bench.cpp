@@ -0,0 +1,145 @@
+// Times the allocation pattern of chunk building: staging triangle lists, then the many small
+// vectors and nodes a builder creates and frees piecemeal. Built twice, once on the system
+// allocator and once with ltalloc replacing operator new, to compare the two.
+#include <stdint.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Arena.hpp"
+
+struct Triangle
+{
+	float data[24];
+};
+
+struct Node
+{
+	int plane;
+	Node* front;
+	Node* back;
+	std::vector<int> surfaces;
+};
+
+static void freeTree(Node* node)
+{
+	if (node == NULL)
+		return;
+	freeTree(node->front);
+	freeTree(node->back);
+	delete node;
+}
+
+static Node* buildTree(std::vector<int>& surfaces, int begin, int end)
+{
+	if (begin >= end)
+		return NULL;
+	Node* node = new Node();
+	node->plane = begin;
+	int mid = (begin + end) / 2;
+	if (end - begin <= 4)
+	{
+		node->surfaces.assign(surfaces.begin() + begin, surfaces.begin() + end);
+		node->front = node->back = NULL;
+		return node;
+	}
+	node->front = buildTree(surfaces, begin, mid);
+	node->back = buildTree(surfaces, mid, end);
+	return node;
+}
+
+// What a builder does per triangle: a named surface with its own winding and a plane
+static uint64_t builderWork(int triangles)
+{
+	std::vector<std::string> materials;
+	std::vector<std::vector<int>> windings;
+	std::vector<float> planes;
+	std::vector<int> surfaces;
+	for (int i = 0; i < triangles; i++)
+	{
+		materials.push_back(std::string("textures/interiors/material_") + std::to_string(i & 15));
+		std::vector<int> winding;
+		for (int j = 0; j < 3 + (i & 3); j++)
+			winding.push_back(i + j);
+		windings.push_back(winding);
+		for (int j = 0; j < 4; j++)
+			planes.push_back((float)i);
+		surfaces.push_back(i);
+	}
+	Node* root = buildTree(surfaces, 0, surfaces.size());
+	uint64_t sum = root != NULL ? root->plane : 0;
+	freeTree(root);
+	return sum + windings.size() + materials.size();
+}
+
+template <typename List>
+static uint64_t stage(List& list, int triangles)
+{
+	Triangle triangle;
+	memset(&triangle, 0, sizeof(triangle));
+	for (int i = 0; i < triangles; i++)
+	{
+		triangle.data[0] = (float)i;
+		list.push_back(triangle);
+	}
+	return list.size();
+}
+
+static double run(int threads, int chunks, int triangles, int mode)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	std::vector<uint64_t> sums(threads);
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([=, &sums]()
+		{
+			for (int c = t; c < chunks; c += threads)
+			{
+				if (mode == 0)
+				{
+					std::vector<Triangle> list;
+					sums[t] += stage(list, triangles);
+				}
+				else if (mode == 1)
+				{
+					Arena arena(triangles * sizeof(Triangle) + 64);
+					std::vector<Triangle, ArenaAllocator<Triangle>> list((ArenaAllocator<Triangle>(&arena)));
+					list.reserve(triangles);
+					sums[t] += stage(list, triangles);
+				}
+				else
+				{
+					sums[t] += builderWork(triangles);
+				}
+			}
+		}));
+	}
+	for (auto& worker : workers)
+		worker.join();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int threads = (argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency());
+	int chunks = (argc > 2 ? atoi(argv[2]) : 64);
+	int triangles = (argc > 3 ? atoi(argv[3]) : 12000);
+	if (threads < 1)
+		threads = 1;
+
+#ifdef OBJ2DIF_LTALLOC
+	printf("allocator: ltalloc\n");
+#else
+	printf("allocator: system\n");
+#endif
+	printf("%d threads, %d chunks of %d triangles\n", threads, chunks, triangles);
+	printf("staging, growing vector: %8.1f ms\n", run(threads, chunks, triangles, 0));
+	printf("staging, chunk arena:    %8.1f ms\n", run(threads, chunks, triangles, 1));
+	printf("builder allocations:     %8.1f ms\n", run(threads, chunks, triangles, 2));
+	return 0;
+}
@@ -1,264 +1,172 @@
 #include <iostream>
-#include <DIFBuilder/DIFBuilder.hpp>
-#include <tiny_obj_loader.h>
-#define GLM_FORCE_INTRINSICS
-#include <glm/glm.hpp>
-#include <dif/objects/dif.h>
-#include <dif/base/io.h>
-#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Analyze.hpp"
+#include "Converter.hpp"
+#include "FileWatcher.hpp"
+#include "Server.hpp"
+#include "Trace.hpp"
+#include "Verify.hpp"
+#include "WorkerPool.hpp"
 
-bool flipNormals = false;
-bool doublesidedfaces = false;
-bool splitbyaxis = false;
-int splitcount = 12000;
-
-std::vector<DIF::DIF> buildInteriors(const char* objpath, std::vector<DIF::Interior>* pathedInteriors = NULL)
+int main(int argc, const char **argv) 
 {
+	printf("obj2difplus 1.2.11\n");
+	printf("originally by HiGuy, rewrite by RandomityGuy\n");
 
-	printf("Loading obj file\n");
-	//Read everything we can
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-	tinyobj::LoadObj(&attrib, &shapes, &materials, &err, objpath);
-
-	printf(err.c_str());
-
-	//Default material
-	materials.push_back(tinyobj::material_t());
-
-	std::vector<DIF::DIFBuilder*> builders;
-	DIF::DIFBuilder* builder = new DIF::DIFBuilder();
-	builders.push_back(builder);
-	int tricount = 0;
-	int alltris = 0;
-
-	// Ok so we calculate the bounding box to offset all geometry to fix the weird origin thing
-
-	glm::vec3 min;
-	glm::vec3 max;
-
-	for (const tinyobj::shape_t shape : shapes)
+	if (argc > 2 && strcmp(argv[1], "-analyze") == 0)
 	{
-		int vertStart = 0;
-		for (int i = 0; i < shape.mesh.num_face_vertices.size(); i++)
+		std::vector<std::string> paths;
+		int iterations = ANALYZE_READ_ITERATIONS;
+		for (int i = 2; i < argc; i++)
 		{
-			tinyobj::index_t idx[3] = {
-					shape.mesh.indices[vertStart + 2],
-					shape.mesh.indices[vertStart + 1],
-					shape.mesh.indices[vertStart + 0]
-			};
-
-			for (int j = 0; j < 3; j++) {
-				glm::vec3 vertex = glm::vec3(
-					attrib.vertices[(idx[j].vertex_index * 3) + 0],
-					-attrib.vertices[(idx[j].vertex_index * 3) + 2],
-					attrib.vertices[(idx[j].vertex_index * 3) + 1]
-				);
-
-				if (min.x > vertex.x)
-					min.x = vertex.x;
-				if (min.y > vertex.y)
-					min.y = vertex.y;
-				if (min.z > vertex.z)
-					min.z = vertex.z;
-
-				if (max.x < vertex.x)
-					max.x = vertex.x;
-				if (max.y < vertex.y)
-					max.y = vertex.y;
-				if (max.z < vertex.z)
-					max.z = vertex.z;
-			}
-
-			vertStart += 3;
+			if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+				iterations = std::max(0, atoi(argv[++i]));
+			else
+				paths.push_back(argv[i]);
 		}
+		return analyzeDifs(paths, iterations);
 	}
 
-	glm::vec3 size = max - min;
-	glm::vec3 off = glm::vec3(1, 1, 1);
-
-
-	for (const tinyobj::shape_t shape : shapes) {
+	if (argc > 1)
+	{
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		bool watchMode = false;
+		bool verifyMode = false;
+		const char* serverSocket = NULL;
+		const char* connectSocket = NULL;
+		const char* tracePath = NULL;
+		int concurrentJobs = 2;
+		std::vector<std::string> args;
 
-		int vertStart = 0;
-		if (tricount > splitcount) //Max BSP Node limit: 32767, max BSP Leaf limit: 16383, hence max polygons = 16383
+		for (int i = 1; i < argc; i++)
 		{
-			tricount = 0;
-			builder = new DIF::DIFBuilder();
-			builders.push_back(builder);
-		}
-		for (int i = 0; i < shape.mesh.num_face_vertices.size(); i++) {
+			const char* arg = argv[i];
 
-			if (tricount > splitcount) //Max BSP Node limit: 32767, max BSP Leaf limit: 16383, hence max polygons = 16383
+			if (strcmp(arg, "-mp") == 0)
 			{
-				tricount = 0;
-				builder = new DIF::DIFBuilder();
-				builders.push_back(builder);
+				args.insert(args.end(), argv + i, argv + argc);
+				break;
 			}
 
-			tinyobj::index_t idx[3] = {
-					shape.mesh.indices[vertStart + 2],
-					shape.mesh.indices[vertStart + 1],
-					shape.mesh.indices[vertStart + 0]
-			};
-
-			DIF::DIFBuilder::Triangle triangle;
+			if (strcmp(arg, "-j") == 0 && i + 1 < argc)
+				numThreads = std::max(1, atoi(argv[i + 1]));
 
-			DIF::DIFBuilder::Triangle invertedTriangle;
+			if (strcmp(arg, "-watch") == 0)
+				watchMode = true;
 
-			for (int j = 0; j < 3; j++) {
-				triangle.points[j].vertex = size + off + glm::vec3(
-					attrib.vertices[(idx[j].vertex_index * 3) + 0],
-					-attrib.vertices[(idx[j].vertex_index * 3) + 2],
-					attrib.vertices[(idx[j].vertex_index * 3) + 1]
-				);
-				triangle.points[j].uv = glm::vec2(
-					attrib.texcoords[(idx[j].texcoord_index * 2) + 0],
-					-attrib.texcoords[(idx[j].texcoord_index * 2) + 1]
-				);
-
-
-				if (attrib.normals.size() != 0)
-					triangle.points[j].normal = glm::vec3(
-						attrib.normals[(idx[j].normal_index * 3) + 0],
-						-attrib.normals[(idx[j].normal_index * 3) + 2],
-						attrib.normals[(idx[j].normal_index * 3) + 1]
-					);
-
-				if (doublesidedfaces)
-				{
-					invertedTriangle.points[j].vertex = size + off + glm::vec3(
-						attrib.vertices[(idx[j].vertex_index * 3) + 1],
-						-attrib.vertices[(idx[j].vertex_index * 3) + 2],
-						attrib.vertices[(idx[j].vertex_index * 3) + 0]
-					);
-					invertedTriangle.points[j].uv = glm::vec2(
-						attrib.texcoords[(idx[j].texcoord_index * 2) + 0],
-						-attrib.texcoords[(idx[j].texcoord_index * 2) + 1]
-					);
+			if (strcmp(arg, "-verify-determinism") == 0)
+			{
+				verifyMode = true;
+				continue;
+			}
 
+			if (strcmp(arg, "-server") == 0 && i + 1 < argc)
+				serverSocket = argv[i + 1];
 
-					if (attrib.normals.size() != 0)
-						invertedTriangle.points[j].normal = glm::vec3(
-							-attrib.normals[(idx[j].normal_index * 3) + 0],
-							attrib.normals[(idx[j].normal_index * 3) + 2],
-							-attrib.normals[(idx[j].normal_index * 3) + 1]
-						);
-				}
+			if (strcmp(arg, "-jobs") == 0 && i + 1 < argc)
+				concurrentJobs = std::max(1, atoi(argv[i + 1]));
 
+			if (strcmp(arg, "-connect") == 0 && i + 1 < argc)
+			{
+				connectSocket = argv[++i];
+				continue;
 			}
 
-			int material = shape.mesh.material_ids[i];
-			tricount++;
-			alltris++;
-			builder->addTriangle(triangle, (material == -1 ? shape.name : materials[material].diffuse_texname.substr(0, materials[material].diffuse_texname.length() - 4)));
-			if (doublesidedfaces)
+			if (strcmp(arg, "-trace") == 0 && i + 1 < argc)
 			{
-				tricount++;
-				alltris++;
-				builder->addTriangle(invertedTriangle, (material == -1 ? shape.name : materials[material].diffuse_texname.substr(0, materials[material].diffuse_texname.length() - 4)));
+				tracePath = argv[++i];
+				startTrace();
+				continue;
 			}
-			//builder.addTriangle(invertedTriangle, (material == -1 ? shape.name : materials[material].name));
 
-			vertStart += 3;
+			args.push_back(arg);
 		}
 
-	}
-
-	printf("Building DIFs for %d triangles\n", alltris);
-
-	std::vector<DIF::DIF> interiors;
-	int index = 0;
-	for (auto& difbuilder : builders)
-	{
-		printf("Building DIF %d/%d\n", index + 1, builders.size());
-
-		DIF::DIF dif;
-		if (index == 0)
+		// The server converts once and has no hashes to compare
+		if (connectSocket != NULL && verifyMode)
 		{
-			if (pathedInteriors != NULL)
-			{
-				for (int i = 0; i < pathedInteriors->size(); i++)
-				{
-					difbuilder->addPathedInterior(pathedInteriors->at(i), std::vector<DIF::DIFBuilder::Marker>());
-				}
-			}
+			printf("-verify-determinism cannot be combined with -connect, run it without the server\n");
+			return 1;
 		}
-		difbuilder->build(dif, flipNormals);
-		interiors.push_back(dif);
-		index++;
-		delete difbuilder;
-	}
-	return interiors;
-}
-
-int main(int argc, const char **argv) 
-{
-	printf("obj2difplus 1.2.11\n");
-	printf("originally by HiGuy, rewrite by RandomityGuy\n");
-
-	if (argc > 1)
-	{
-		std::vector<std::string> mppaths;
 
-		bool scanningMPpaths = false;
+		if (connectSocket != NULL)
+			return runClient(connectSocket, args);
 
-		for (int i = 1; i < argc; i++)
+		if (verifyMode && serverSocket == NULL)
 		{
-			const char* arg = argv[i];
+			ConvertJob job;
+			parseJobArguments(args, job);
+			int status = verifyDeterminism(job, numThreads);
+			if (tracePath != NULL && !writeTrace(tracePath))
+				printf("Failed to write %s\n", tracePath);
+			return status;
+		}
 
-			if (!scanningMPpaths)
-			{
-				if (strcmp(arg, "-flip") == 0)
-					flipNormals = true;
+		WorkerPool pool(numThreads);
 
-				if (strcmp(arg, "-double") == 0)
-					doublesidedfaces = true;
+		if (serverSocket != NULL)
+			return runServer(serverSocket, pool, concurrentJobs);
 
-				if (strcmp(arg, "-splitcount") == 0)
-					splitcount = fmin(atoi(argv[i + 1]), 16000);
+		ConvertJob job;
+		parseJobArguments(args, job);
 
-				if (strcmp(arg, "-mp") == 0)
-					scanningMPpaths = true;
-			}
-			else
-			{
-				mppaths.push_back(std::string(argv[i]));
-			}
-		}
-
-		std::vector<DIF::Interior> mps;
-
-		for (int i = 0; i < mppaths.size(); i++)
+		if (!watchMode)
 		{
-			std::vector<DIF::DIF> mp = buildInteriors(mppaths[i].c_str());
-			for (int j = 0; j < mp.size(); j++)
-				mps.push_back(mp[j].interior[0]);
+			bool ok = convert(job, pool).ok;
+			if (tracePath != NULL && !writeTrace(tracePath))
+				printf("Failed to write %s\n", tracePath);
+			return ok ? 0 : 1;
 		}
 
-		std::vector<DIF::DIF> interiors = buildInteriors(argv[1]);
-
-
-		for (int i = 0; i < interiors.size(); i++)
+		enableConversionCaches();
+		FileWatcher watcher;
+		for (;;)
 		{
-			DIF::DIF dif = interiors[i];
-			std::ofstream outStr;
-			char buf[16];
-			outStr.open(std::string(argv[1]).substr(0, strlen(argv[1]) - 4) + std::string(itoa(i, buf, 10)) + ".dif", std::ios::out | std::ios::binary);
-			dif.write(outStr, DIF::Version());
+			ConvertResult result = convert(job, pool);
+			trimConversionCaches(result.generation, SIZE_MAX, SIZE_MAX, SIZE_MAX);
+			watcher.setFiles(result.files);
+			if (tracePath != NULL && !writeTrace(tracePath))
+				printf("Failed to write %s\n", tracePath);
+
+			printf("Watching %d files for changes\n", (int)result.files.size());
+			std::vector<std::string> changed = watcher.wait();
+			for (const std::string& file : changed)
+				printf("%s changed\n", file.c_str());
 		}
-
 	}
 	else
 	{
 		printf("Usage:\n");
-		printf("obj2difplus <file> [-flip] [-double] [-splitcount <count>] [-mp <path1> [<path2> ...]]\n");
+		printf("obj2difplus <file> [-flip] [-double] [-no-normals] [-sort-materials] [-manifest] [-lightmaps] [-ao-samples <n>] [-profile <full|collision|visual>] [-collision-proxy <error>] [-instances] [-keep-objects] [-splitcount <count>] [-max-memory <MB>] [-j <threads>] [-watch] [-trace <file>] [-verify-determinism | -connect <socket>] [-priority <n>] [-mp <path1> [<path2> ...]]\n");
+		printf("obj2difplus -server <socket> [-j <threads>] [-jobs <count>]\n");
+		printf("obj2difplus -analyze <dif> [<dif> ...] [-iterations <count>]\n");
 		printf("file: path to the obj file to convert\n");
 		printf("flip: (optional) flip normals\n");
 		printf("double: (optional) make all faces double sided\n");
+		printf("no-normals: (optional) skip the normals in the obj, faster loading for collision maps\n");
+		printf("sort-materials: (optional) order the triangles of each dif by material and report the texture batches\n");
+		printf("manifest: (optional) write the bounds, counts, textures and size of every dif to <file>.manifest.json and <file>.manifest.cs\n");
+		printf("lightmaps: (optional) bake sunlight, shadows and ambient occlusion into the lightmaps of every dif\n");
+		printf("ao-samples <n>: (optional) ambient occlusion rays per lumel when baking lightmaps, defaults to 16\n");
+		printf("profile <full|collision|visual>: (optional) make the whole obj collision-only or visual-only, materials named collision_* and nocol_* always are\n");
+		printf("collision-proxy <error>: (optional) collide with a copy of every dif decimated up to <error> units, written as extra difs after the others\n");
+		printf("instances: (optional) build objects repeated through the map once as <file>_prop<n>.dif and place their copies from <file>.instances.cs\n");
+		printf("keep-objects: (optional) keep every object in one dif, packing nearby small objects together, unless it has more triangles than splitcount\n");
 		printf("splitcount <count>: (optional) changes the amount of triangles required till a split is required\n");
+		printf("max-memory <MB>: (optional) memory the difs waiting to be built may use, the rest wait in a temp file\n");
+		printf("j <threads>: (optional) number of difs to build in parallel, defaults to the number of cores\n");
+		printf("watch: (optional) keep running and reconvert whenever the obj, its mtl files or the moving platforms change\n");
+		printf("verify-determinism: (optional) build on 1 and on <threads> threads, check the difs are identical and write their hashes to <file>.hashes\n");
+		printf("trace <file>: (optional) write a timeline of the conversion to <file> in the chrome trace format\n");
+		printf("server <socket>: run as a conversion server listening on the given unix socket\n");
+		printf("jobs <count>: (optional) number of conversions the server runs at once, defaults to 2\n");
+		printf("connect <socket>: (optional) hand the conversion to the server listening on the given socket, not together with -verify-determinism\n");
+		printf("priority <n>: (optional) jobs with a higher priority are built first by the server\n");
+		printf("analyze <dif> [<difs>..]: print the bsp, surface, plane and hull counts, size, read-back time and bounds overlap of the difs\n");
+		printf("iterations <count>: (optional) times each dif is parsed to time the read-back, defaults to 10\n");
 		printf("mp <path1> [<paths>..]: (optional) list of paths to obj files to use as moving platforms\n");
 	}
 	return 0;
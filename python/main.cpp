@@ -0,0 +1,107 @@
+// Python module running the obj to dif conversion
+//
+// usage:
+// import obj2dif
+// count = obj2dif.convert("map.obj", flip=False, double=False, splitcount=12000, mp=["platform.obj"], threads=0, max_memory=0, sort_materials=False, manifest=False, lightmaps=False, ao_samples=16, profile="full", collision_error=0.0, instances=False, keep_objects=False, no_normals=False)
+//
+// Parsing the objs and building the difs happens without holding the GIL. Use the tinyobjloader
+// module to read the obj data itself as NumPy arrays.
+
+#include <Python.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "../Converter.hpp"
+#include "../WorkerPool.hpp"
+
+static PyObject* pyConvert(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = { "path", "flip", "double", "splitcount", "mp", "threads", "max_memory", "sort_materials", "manifest", "lightmaps", "ao_samples", "profile", "collision_error", "instances", "keep_objects", "no_normals", NULL };
+	const char* path;
+	int flip = 0;
+	int doublesided = 0;
+	int splitcount = 12000;
+	PyObject* mp = NULL;
+	int threads = 0;
+	unsigned long long maxMemory = 0;
+	int sortMaterials = 0;
+	int manifest = 0;
+	int lightmaps = 0;
+	int aoSamples = 16;
+	const char* profile = "full";
+	float collisionError = 0;
+	int instances = 0;
+	int keepObjects = 0;
+	int noNormals = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ppiOiKpppisfppp", const_cast<char**>(keywords), &path, &flip, &doublesided, &splitcount, &mp, &threads, &maxMemory, &sortMaterials, &manifest, &lightmaps, &aoSamples, &profile, &collisionError, &instances, &keepObjects, &noNormals))
+		return NULL;
+
+	ConvertJob job;
+	job.objpath = path;
+	job.options.flipNormals = flip != 0;
+	job.options.doublesidedfaces = doublesided != 0;
+	job.options.ignoreNormals = noNormals != 0;
+	job.options.sortMaterials = sortMaterials != 0;
+	job.options.bakeLightmaps = lightmaps != 0;
+	job.options.aoSamples = std::max(0, aoSamples);
+	job.options.collisionError = std::max(0.0f, collisionError);
+	job.options.instanceProps = instances != 0;
+	job.options.keepObjects = keepObjects != 0;
+	if (!parseProfile(profile, job.options.profile))
+	{
+		PyErr_SetString(PyExc_ValueError, "profile must be full, collision or visual");
+		return NULL;
+	}
+	job.options.splitcount = fmin(splitcount, 16000);
+	job.options.maxMemory = maxMemory * 1024 * 1024;
+	job.writeManifest = manifest != 0;
+
+	if (mp != NULL && mp != Py_None)
+	{
+		PyObject* paths = PySequence_Fast(mp, "mp must be a list of paths");
+		if (paths == NULL)
+			return NULL;
+		for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(paths); i++)
+		{
+			const char* mppath = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(paths, i));
+			if (mppath == NULL)
+			{
+				Py_DECREF(paths);
+				return NULL;
+			}
+			job.mppaths.push_back(mppath);
+		}
+		Py_DECREF(paths);
+	}
+
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+	ConvertResult result;
+	Py_BEGIN_ALLOW_THREADS
+	{
+		WorkerPool pool(threads);
+		result = convert(job, pool);
+	}
+	Py_END_ALLOW_THREADS
+
+	if (!result.ok)
+	{
+		PyErr_Format(PyExc_RuntimeError, "Failed to convert %s: %s", path, result.error.c_str());
+		return NULL;
+	}
+	return PyLong_FromLong(result.difCount);
+}
+
+static PyMethodDef methods[] = {
+	{ "convert", reinterpret_cast<PyCFunction>(pyConvert), METH_VARARGS | METH_KEYWORDS, "Converts an obj to difs next to it and returns how many were written" },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef moduledef = { PyModuleDef_HEAD_INIT, "obj2dif", NULL, -1, methods };
+
+PyMODINIT_FUNC PyInit_obj2dif(void)
+{
+	return PyModule_Create(&moduledef);
+}